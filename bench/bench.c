@@ -0,0 +1,457 @@
+// Benchmark suite for links: times the core operations in-process over
+// generated models from 10 to 1M ports and writes medians and
+// percentiles as JSON, so runs can be compared release to release.
+//
+// links.c is compiled into this file so internal functions can be timed
+// directly. Run with 'make bench'; see print_bench_usage() for options.
+
+#define main links_main
+#include "../src/links.c"
+#undef main
+
+#define BENCH_MIN_SAMPLES 3
+#define BENCH_MAX_SAMPLES 15
+#define BENCH_BUDGET_S 2.0      // Stop sampling an op after this much time
+#define BENCH_LOOKUPS 100000    // Lookups per get_module/get_port sample
+#define BENCH_BATCH 1000        // Adds/lists per sample
+#define BENCH_WORK_DIR "bench/work"
+#define BENCH_MAX_THREADS 32    // Thread sweep runs 1, 2, 4, ... up to this
+
+typedef struct {
+    int ports;                  // Target size; the generator lands close to it
+    int modules;
+    int ports_per;
+} BenchSize;
+
+static const BenchSize bench_sizes[] = {
+    { 10, 2, 5 },
+    { 1000, 100, 10 },
+    { 10000, 1000, 10 },
+    { 100000, 10000, 10 },
+    { 1000000, 100000, 10 },
+};
+#define BENCH_SIZES (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+typedef struct {
+    const char* op;
+    int size;                   // Target ports of the model
+    int modules, ports;         // Actual model
+    long items;                 // Work items per sample (ports, lookups, ...)
+    int threads;                // Pool size of a thread-sweep row; 0 = run default
+    int n;
+    double samples[BENCH_MAX_SAMPLES];
+} BenchResult;
+
+static BenchResult* results = NULL;
+static int n_results = 0, cap_results = 0;
+static int null_fd = -1, stdout_fd = -1;
+static const char* links_bin = "src/links";
+
+double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Commands print as they go; that output goes to /dev/null while timing
+void bench_quiet(bool on) {
+    fflush(stdout);
+    dup2(on ? null_fd : stdout_fd, STDOUT_FILENO);
+}
+
+int bench_port_count() {
+    int n = 0;
+    for (Module* m = root_modules; m; m = m->next)
+        for (Port* p = m->ports; p; p = p->next) n++;
+    return n;
+}
+
+BenchResult* bench_begin(const char* op, const BenchSize* size, long items) {
+    if (n_results == cap_results) {
+        cap_results = cap_results ? cap_results * 2 : 64;
+        results = (BenchResult*)realloc(results, cap_results * sizeof(BenchResult));
+        if (!results) { fprintf(stderr, "Memory allocation failed\n"); exit(1); }
+    }
+    BenchResult* r = &results[n_results++];
+    memset(r, 0, sizeof(*r));
+    r->op = op;
+    r->size = size->ports;
+    r->modules = module_count;
+    r->ports = bench_port_count();
+    r->items = items;
+    return r;
+}
+
+// Keep sampling until the budget is spent (but at least the minimum)
+bool bench_more(BenchResult* r) {
+    double total = 0;
+    for (int i = 0; i < r->n; i++) total += r->samples[i];
+    if (r->n < BENCH_MIN_SAMPLES) return true;
+    return r->n < BENCH_MAX_SAMPLES && total < BENCH_BUDGET_S;
+}
+
+void bench_load() {
+    model_free();
+    load_xml();
+}
+
+int bench_cmp(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted samples
+double bench_pct(const double* s, int n, double pct) {
+    int k = (int)(pct / 100.0 * n + 0.999999) - 1;
+    if (k < 0) k = 0;
+    if (k >= n) k = n - 1;
+    return s[k];
+}
+
+// --- Operations ---
+
+void bench_load_save(const BenchSize* size) {
+    BenchResult* r = bench_begin("load_xml", size, 0);
+    while (bench_more(r)) {
+        model_free();
+        double t = bench_now();
+        load_xml();
+        r->samples[r->n++] = bench_now() - t;
+    }
+    r->modules = module_count;
+    r->ports = bench_port_count();
+    r->items = r->ports;
+
+    r = bench_begin("save_xml", size, bench_port_count());
+    while (bench_more(r)) {
+        double t = bench_now();
+        save_xml();
+        r->samples[r->n++] = bench_now() - t;
+    }
+}
+
+void bench_lookups(const BenchSize* size, uint64_t* rng) {
+    int n = 0;
+    Module** mods = module_array(&n);
+    Module** picks = (Module**)xcalloc(BENCH_LOOKUPS, sizeof(Module*));
+    Port** ports = (Port**)xcalloc(BENCH_LOOKUPS, sizeof(Port*));
+    int found = 0;
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        picks[i] = mods[gen_below(rng, n)];
+        int count = 0;
+        for (Port* p = picks[i]->ports; p; p = p->next) count++;
+        int k = gen_below(rng, count);
+        Port* p = picks[i]->ports;
+        while (k-- > 0) p = p->next;
+        ports[i] = p;
+    }
+
+    BenchResult* r = bench_begin("get_module", size, BENCH_LOOKUPS);
+    while (bench_more(r)) {
+        double t = bench_now();
+        for (int i = 0; i < BENCH_LOOKUPS; i++) found += get_module(picks[i]->name, false) != NULL;
+        r->samples[r->n++] = bench_now() - t;
+    }
+    r = bench_begin("get_port", size, BENCH_LOOKUPS);
+    while (bench_more(r)) {
+        double t = bench_now();
+        for (int i = 0; i < BENCH_LOOKUPS; i++)
+            found += ports[i] && get_port(picks[i], ports[i]->name, false) != NULL;
+        r->samples[r->n++] = bench_now() - t;
+    }
+    if (found == 0) fprintf(stderr, "  (no lookups matched)\n");
+    free(picks);
+    free(ports);
+    free(mods);
+}
+
+// Links new ports between existing modules; the model is reloaded
+// (untimed) before each sample so every sample starts from the same size
+void bench_add(const BenchSize* size, uint64_t* rng) {
+    char src[BENCH_BATCH][MAX_STR * 2], dst[BENCH_BATCH][MAX_STR * 2];
+    BenchResult* r = bench_begin("cmd_add", size, BENCH_BATCH);
+    while (bench_more(r)) {
+        bench_load();
+        int n = 0;
+        Module** mods = module_array(&n);
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            snprintf(src[i], sizeof(src[i]), "%s::bench_o%d:int", mods[gen_below(rng, n)]->name, i);
+            snprintf(dst[i], sizeof(dst[i]), "%s::bench_i%d", mods[gen_below(rng, n)]->name, i);
+        }
+        free(mods);
+        bench_quiet(true);
+        double t = bench_now();
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            char* argv[] = { "links", "add", src[i], dst[i], NULL };
+            cmd_add(4, argv);
+        }
+        double dt = bench_now() - t;
+        bench_quiet(false);
+        r->samples[r->n++] = dt;
+    }
+    bench_load();
+}
+
+void bench_list_draw(const BenchSize* size, uint64_t* rng) {
+    int n = 0;
+    Module** mods = module_array(&n);
+    BenchResult* r = bench_begin("cmd_list", size, BENCH_BATCH);
+    while (bench_more(r)) {
+        bench_quiet(true);
+        double t = bench_now();
+        for (int i = 0; i < BENCH_BATCH; i++) cmd_list(mods[gen_below(rng, n)]->name);
+        double dt = bench_now() - t;
+        bench_quiet(false);
+        r->samples[r->n++] = dt;
+    }
+    free(mods);
+
+    r = bench_begin("cmd_draw", size, bench_port_count());
+    while (bench_more(r)) {
+        bench_quiet(true);
+        double t = bench_now();
+        cmd_draw();
+        double dt = bench_now() - t;
+        bench_quiet(false);
+        r->samples[r->n++] = dt;
+    }
+}
+
+// DOT text generation (Graphviz itself is not timed), the native
+// engine's layout plus SVG, and its layout cold and warm
+void bench_dot(const BenchSize* size) {
+    DotOptions opt;
+    char* argv[] = { "links", "dot", NULL };
+    parse_dot_options(2, argv, &opt);
+    BenchResult* r = bench_begin("dot_text", size, bench_port_count());
+    while (bench_more(r)) {
+        size_t len = 0;
+        double t = bench_now();
+        char* text = build_dot_text(&opt, NULL, &len);
+        r->samples[r->n++] = bench_now() - t;
+        free(text);
+    }
+
+    r = bench_begin("dot_native", size, module_count);
+    while (bench_more(r)) {
+        double t = bench_now();
+        Graph* g = graph_build(NULL);
+        int reused = 0;
+        Layout* lay = layout_run(g, true, &reused);
+        native_write_svg(g, lay, "graph.svg");
+        r->samples[r->n++] = bench_now() - t;
+        layout_free(lay);
+        graph_free(g);
+    }
+
+    // Layout alone, from scratch and warm-started from the saved layout
+    // of an unchanged model
+    Graph* g = graph_build(NULL);
+    int reused = 0;
+    Layout* lay = layout_run(g, true, &reused);
+    layout_save(lay, g, LAYOUT_FILE);
+    layout_free(lay);
+    r = bench_begin("layout_fresh", size, module_count);
+    while (bench_more(r)) {
+        double t = bench_now();
+        lay = layout_run(g, true, &reused);
+        r->samples[r->n++] = bench_now() - t;
+        layout_free(lay);
+    }
+    r = bench_begin("layout_warm", size, module_count);
+    while (bench_more(r)) {
+        double t = bench_now();
+        lay = layout_run(g, false, &reused);
+        r->samples[r->n++] = bench_now() - t;
+        layout_free(lay);
+    }
+    graph_free(g);
+}
+
+// End-to-end latency of the real binary, including load and save.
+// Returns the result row, or NULL if the binary could not be run.
+BenchResult* bench_cli(const BenchSize* size, const char* op, char* const* args) {
+    BenchResult* r = bench_begin(op, size, 1);
+    while (bench_more(r)) {
+        pid_t pid;
+        posix_spawn_file_actions_t fa;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_adddup2(&fa, null_fd, STDOUT_FILENO);
+        double t = bench_now();
+        if (posix_spawn(&pid, args[0], &fa, NULL, args, environ) != 0) {
+            posix_spawn_file_actions_destroy(&fa);
+            fprintf(stderr, "  could not run %s\n", args[0]);
+            n_results--;
+            return NULL;
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        r->samples[r->n++] = bench_now() - t;
+        posix_spawn_file_actions_destroy(&fa);
+    }
+    return r;
+}
+
+// Scaling of the pool-parallel passes, one row per thread count:
+// check_range under cmd_check and the CLI, and dsm_fill_range on a
+// prebuilt DSM (its ordering and graph build are serial and not timed)
+void bench_threads(const BenchSize* size, const char* links_path) {
+    int saved = opt_threads;
+    Dsm* d = module_count <= DSM_MAX_MODULES ? dsm_build("list", "prefix") : NULL;
+    for (int t = 1; t <= BENCH_MAX_THREADS; t *= 2) {
+        opt_threads = t;
+        pool_shutdown(); // The next parallel pass starts a pool of t workers
+        BenchResult* r = bench_begin("check_range", size, bench_port_count());
+        r->threads = t;
+        while (bench_more(r)) {
+            bench_quiet(true);
+            double start = bench_now();
+            cmd_check();
+            r->samples[r->n++] = bench_now() - start;
+            bench_quiet(false);
+        }
+
+        if (d) {
+            r = bench_begin("dsm_fill", size, module_count);
+            r->threads = t;
+            DsmFillCtx ctx = { d, (long*)xcalloc(d->n, sizeof(long)), (long*)xcalloc(d->n, sizeof(long)) };
+            while (bench_more(r)) {
+                memset(d->bits, 0, (size_t)d->n * d->words * sizeof(uint64_t));
+                double start = bench_now();
+                pool_parallel_for(d->n, 256, dsm_fill_range, &ctx);
+                r->samples[r->n++] = bench_now() - start;
+            }
+            free(ctx.above);
+            free(ctx.links);
+        }
+
+        char threads[16];
+        snprintf(threads, sizeof(threads), "%d", t);
+        char* check_args[] = { (char*)links_path, "--threads", threads, "check", NULL };
+        r = bench_cli(size, "cli_check", check_args);
+        if (r) r->threads = t;
+    }
+    if (d) dsm_free(d);
+    opt_threads = saved;
+    pool_shutdown();
+}
+
+// --- Report ---
+
+void bench_write_json(FILE* f) {
+    time_t now = time(NULL);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    fprintf(f, "{\n  \"version\": 1,\n  \"timestamp\": \"%s\",\n  \"threads\": %d,\n  \"results\": [\n",
+            stamp, pool_thread_count());
+    for (int i = 0; i < n_results; i++) {
+        BenchResult* r = &results[i];
+        double s[BENCH_MAX_SAMPLES];
+        memcpy(s, r->samples, r->n * sizeof(double));
+        qsort(s, r->n, sizeof(double), bench_cmp);
+        double median = r->n % 2 ? s[r->n / 2] : (s[r->n / 2 - 1] + s[r->n / 2]) / 2;
+        char threads[32] = "";
+        if (r->threads) snprintf(threads, sizeof(threads), "\"threads\": %d, ", r->threads);
+        fprintf(f, "    {\"op\": \"%s\", %s\"size\": %d, \"modules\": %d, \"ports\": %d, \"items\": %ld, "
+                   "\"samples\": %d, \"unit\": \"s\", \"median\": %.9f, \"p10\": %.9f, \"p90\": %.9f, "
+                   "\"p99\": %.9f, \"min\": %.9f, \"max\": %.9f, \"items_per_s\": %.1f}%s\n",
+                r->op, threads, r->size, r->modules, r->ports, r->items, r->n, median,
+                bench_pct(s, r->n, 10), bench_pct(s, r->n, 90), bench_pct(s, r->n, 99),
+                s[0], s[r->n - 1], median > 0 ? r->items / median : 0.0,
+                i + 1 < n_results ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+void print_bench_usage() {
+    printf("Usage: bench [-o results.json] [--max-ports N] [--links path/to/links] [--threads N] [--cli-only]\n");
+    printf("  Times load/save, lookups, add, list, draw, DOT generation, native layout\n");
+    printf("  and CLI latency on generated models of 10 to 1M ports, and sweeps the\n");
+    printf("  parallel check and DSM fill over 1 to %d threads.\n", BENCH_MAX_THREADS);
+    printf("  --cli-only times just the CLI runs of --links, to compare builds of it.\n");
+}
+
+int main(int argc, char* argv[]) {
+    argc = parse_global_options(argc, argv);
+    const char* output = "bench/results.json";
+    int max_ports = 1000000;
+    bool cli_only = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+        else if (strcmp(argv[i], "--max-ports") == 0 && i + 1 < argc) max_ports = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--links") == 0 && i + 1 < argc) links_bin = argv[++i];
+        else if (strcmp(argv[i], "--cli-only") == 0) cli_only = true;
+        else { print_bench_usage(); return strcmp(argv[i], "-h") == 0 ? 0 : 1; }
+    }
+
+    // Resolve paths before moving into the scratch directory
+    FILE* out = fopen(output, "w");
+    if (!out) { fprintf(stderr, "Error: Could not write '%s'.\n", output); return 1; }
+    char links_path[4096] = "";
+    if (links_bin[0] != '/' && !getcwd(links_path, sizeof(links_path) - MAX_STR)) return 1;
+    if (links_path[0]) strcat(links_path, "/");
+    strncat(links_path, links_bin, sizeof(links_path) - strlen(links_path) - 1);
+    if (access(links_path, X_OK) != 0) {
+        fprintf(stderr, "Error: '%s' not found (build it with 'make links').\n", links_bin);
+        return 1;
+    }
+    mkdir("bench", 0755);
+    mkdir(BENCH_WORK_DIR, 0755);
+    if (chdir(BENCH_WORK_DIR) != 0) { fprintf(stderr, "Error: Could not enter %s.\n", BENCH_WORK_DIR); return 1; }
+    null_fd = open("/dev/null", O_WRONLY);
+    stdout_fd = dup(STDOUT_FILENO);
+
+    uint64_t rng = 42;
+    for (int s = 0; s < BENCH_SIZES && bench_sizes[s].ports <= max_ports; s++) {
+        const BenchSize* size = &bench_sizes[s];
+        char modules[16], ports_per[16];
+        snprintf(modules, sizeof(modules), "%d", size->modules);
+        snprintf(ports_per, sizeof(ports_per), "%d", size->ports_per);
+        char* gen_argv[] = { "links", "gen", "--modules", modules, "--ports-per", ports_per,
+                             "--seed", "1", "--force", NULL };
+        bench_quiet(true);
+        cmd_gen(9, gen_argv);
+        bench_quiet(false);
+        fprintf(stderr, "bench: %d ports (%d modules)\n", size->ports, size->modules);
+
+        if (cli_only) {
+            bench_load();
+        } else {
+            bench_load_save(size);
+            bench_lookups(size, &rng);
+            bench_add(size, &rng);
+            bench_list_draw(size, &rng);
+            bench_dot(size);
+            bench_threads(size, links_path);
+        }
+
+        char* list_args[] = { links_path, "list", root_modules->name, NULL };
+        bench_cli(size, "cli_list", list_args);
+        char* check_args[] = { links_path, "check", NULL };
+        bench_cli(size, "cli_check", check_args);
+        char* draw_args[] = { links_path, "draw", NULL };
+        bench_cli(size, "cli_draw", draw_args);
+        char* dot_args[] = { links_path, "dot", "--engine", "native", "--fresh", NULL };
+        bench_cli(size, "cli_dot_native", dot_args);
+        model_free();
+    }
+    pool_shutdown();
+
+    bench_write_json(out);
+    fclose(out);
+
+    // Short human summary; the JSON has the full distribution
+    fprintf(stderr, "\n%-14s %7s %9s %12s %12s %14s\n", "op", "threads", "ports", "median(s)", "p90(s)", "items/s");
+    for (int i = 0; i < n_results; i++) {
+        BenchResult* r = &results[i];
+        qsort(r->samples, r->n, sizeof(double), bench_cmp);
+        double median = r->n % 2 ? r->samples[r->n / 2] : (r->samples[r->n / 2 - 1] + r->samples[r->n / 2]) / 2;
+        char threads[16] = "-";
+        if (r->threads) snprintf(threads, sizeof(threads), "%d", r->threads);
+        fprintf(stderr, "%-14s %7s %9d %12.6f %12.6f %14.0f\n", r->op, threads, r->ports, median,
+                bench_pct(r->samples, r->n, 90), median > 0 ? r->items / median : 0.0);
+    }
+    fprintf(stderr, "\nWrote %s\n", output);
+    free(results);
+    return 0;
+}
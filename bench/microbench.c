@@ -0,0 +1,340 @@
+// Microbenchmarks for the primitives on the load and batch hot paths:
+// str_to_dir, parse_arg_safe, get_module and get_port. Each one is timed
+// in cycles per call across name lengths and table sizes. It runs next to
+// candidate replacements, so a hot-path change can point at numbers:
+//
+//   baseline  the code as it is in links.c (get_module's linear scan is
+//             kept here as the pre-index reference)
+//   indexed   a hash lookup instead of a list walk
+//   interned  names interned once, so lookups hash and compare pointers
+//
+// links.c is compiled into this file like bench.c. Run with
+// 'make microbench'.
+
+#define main links_main
+#include "../src/links.c"
+#undef main
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MB_UNIT "cycles"
+static inline uint64_t mb_ticks() { return __rdtsc(); }
+#else
+#define MB_UNIT "ns"
+static inline uint64_t mb_ticks() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+#define MB_SAMPLES 11
+#define MB_CALLS 20000          // Calls per sample
+
+static volatile uintptr_t mb_sink;  // Keeps results alive
+
+static const int mb_name_lens[] = { 8, 24, 60 };
+static const int mb_module_counts[] = { 16, 1024, 65536 };
+static const int mb_port_counts[] = { 4, 32, 256 };
+#define MB_COUNT(a) (int)(sizeof(a) / sizeof((a)[0]))
+
+int mb_cmp(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Median and minimum ticks per call over MB_SAMPLES samples
+void mb_time(const char* primitive, const char* variant, int size, int len,
+             void (*run)(void* ctx, int calls), void* ctx) {
+    double s[MB_SAMPLES];
+    run(ctx, MB_CALLS / 10); // Warm caches and branch predictors
+    for (int i = 0; i < MB_SAMPLES; i++) {
+        uint64_t t = mb_ticks();
+        run(ctx, MB_CALLS);
+        s[i] = (double)(mb_ticks() - t) / MB_CALLS;
+    }
+    qsort(s, MB_SAMPLES, sizeof(double), mb_cmp);
+    printf("%-14s %-9s %7d %5d %10.1f %10.1f\n", primitive, variant, size, len, s[MB_SAMPLES / 2], s[0]);
+}
+
+// A name of exactly 'len' characters. The index sits at the end, so names
+// share a long prefix the way generated and real module names do.
+void mb_name(char* out, const char* prefix, int i, int len) {
+    char digits[16];
+    int nd = snprintf(digits, sizeof(digits), "%d", i);
+    int np = len - nd;
+    if (np < 1) np = 1;
+    for (int k = 0; k < np; k++) out[k] = prefix[k % strlen(prefix)];
+    memcpy(out + np, digits, nd + 1);
+}
+
+// --- Candidate variants ---
+
+// One comparison on the first byte decides almost every input
+Direction str_to_dir_switch(const char* s) {
+    switch (s[0]) {
+    case 'i': return s[1] == 'n' && s[2] == '\0' ? DIR_IN : DIR_NONE;
+    case 'o': return s[1] == 'u' && s[2] == 't' && s[3] == '\0' ? DIR_OUT : DIR_NONE;
+    default: return DIR_NONE;
+    }
+}
+
+// Same contract as parse_arg_safe, in a single scan with no strlen/strstr
+bool parse_arg_onepass(const char* input, char* m_out, char* p_out, char* t_out) {
+    m_out[0] = p_out[0] = t_out[0] = '\0';
+    if (!input || !input[0]) return false;
+    const char* s = input;
+    char* out = m_out;
+    int n = 0, field = 0;
+    for (; *s; s++) {
+        if (field == 0 && s[0] == ':' && s[1] == ':') {
+            out[n] = '\0'; out = p_out; n = 0; field = 1; s++;
+            continue;
+        }
+        if (field == 1 && s[0] == ':') {
+            out[n] = '\0'; out = t_out; n = 0; field = 2;
+            continue;
+        }
+        if (n < MAX_STR - 1) out[n++] = *s;
+    }
+    out[n] = '\0';
+    return m_out[0] != '\0';
+}
+
+// The list walk get_module did before the hash index
+Module* get_module_linear(const char* name) {
+    for (Module* m = root_modules; m; m = m->next)
+        if (strcmp(m->name, name) == 0) return m;
+    return NULL;
+}
+
+// Open-addressing table keyed by pointer: for callers that hold interned
+// names, a lookup is one multiply and a pointer compare per probe
+typedef struct {
+    const void** keys;
+    void** vals;
+    size_t cap;
+} PtrMap;
+
+size_t ptr_hash(const void* p) {
+    return (size_t)(((uintptr_t)p >> 4) * 0x9E3779B97F4A7C15ULL);
+}
+
+void ptr_map_init(PtrMap* pm, int n) {
+    pm->cap = 16;
+    while (pm->cap < (size_t)n * 2) pm->cap *= 2;
+    pm->keys = (const void**)xcalloc(pm->cap, sizeof(void*));
+    pm->vals = (void**)xcalloc(pm->cap, sizeof(void*));
+}
+
+void ptr_map_put(PtrMap* pm, const void* key, void* val) {
+    size_t h = ptr_hash(key) & (pm->cap - 1);
+    while (pm->keys[h] && pm->keys[h] != key) h = (h + 1) & (pm->cap - 1);
+    pm->keys[h] = key;
+    pm->vals[h] = val;
+}
+
+void* ptr_map_get(PtrMap* pm, const void* key) {
+    size_t h = ptr_hash(key) & (pm->cap - 1);
+    while (pm->keys[h]) {
+        if (pm->keys[h] == key) return pm->vals[h];
+        h = (h + 1) & (pm->cap - 1);
+    }
+    return NULL;
+}
+
+void ptr_map_free(PtrMap* pm) {
+    free(pm->keys);
+    free(pm->vals);
+}
+
+// Per-module port index keyed by name hash, like module_table
+typedef struct {
+    Port** slots;
+    size_t cap;
+} PortIndex;
+
+void port_index_build(PortIndex* pi, Module* m, int n) {
+    pi->cap = 16;
+    while (pi->cap < (size_t)n * 2) pi->cap *= 2;
+    pi->slots = (Port**)xcalloc(pi->cap, sizeof(Port*));
+    for (Port* p = m->ports; p; p = p->next) {
+        size_t h = fnv1a64(p->name, strlen(p->name)) & (pi->cap - 1);
+        while (pi->slots[h]) h = (h + 1) & (pi->cap - 1);
+        pi->slots[h] = p;
+    }
+}
+
+Port* port_index_get(PortIndex* pi, const char* name) {
+    size_t h = fnv1a64(name, strlen(name)) & (pi->cap - 1);
+    while (pi->slots[h]) {
+        if (strcmp(pi->slots[h]->name, name) == 0) return pi->slots[h];
+        h = (h + 1) & (pi->cap - 1);
+    }
+    return NULL;
+}
+
+// --- Cases ---
+
+typedef struct {
+    char (*args)[MAX_STR * 3];
+    int n;
+} ParseCtx;
+
+void run_parse_baseline(void* arg, int calls) {
+    ParseCtx* c = (ParseCtx*)arg;
+    char m[MAX_STR], p[MAX_STR], t[MAX_STR];
+    for (int i = 0; i < calls; i++) mb_sink += parse_arg_safe(c->args[i % c->n], m, p, t) + p[0];
+}
+
+void run_parse_onepass(void* arg, int calls) {
+    ParseCtx* c = (ParseCtx*)arg;
+    char m[MAX_STR], p[MAX_STR], t[MAX_STR];
+    for (int i = 0; i < calls; i++) mb_sink += parse_arg_onepass(c->args[i % c->n], m, p, t) + p[0];
+}
+
+static char* dir_inputs[] = { "in", "out", "none", "in", "out", "bogus", "out", "in" };
+
+void run_dir_baseline(void* arg, int calls) {
+    (void)arg;
+    for (int i = 0; i < calls; i++) mb_sink += str_to_dir(dir_inputs[i & 7]);
+}
+
+void run_dir_switch(void* arg, int calls) {
+    (void)arg;
+    for (int i = 0; i < calls; i++) mb_sink += str_to_dir_switch(dir_inputs[i & 7]);
+}
+
+typedef struct {
+    char (*names)[MAX_STR];     // Lookup keys, as a parser would hand them over
+    const char** interned;      // The same keys as interned pointers
+    int n;
+    PtrMap by_ptr;
+    Module* mod;                // get_port cases: the module searched
+    PortIndex ports;
+} LookupCtx;
+
+void run_module_linear(void* arg, int calls) {
+    LookupCtx* c = (LookupCtx*)arg;
+    for (int i = 0; i < calls; i++) mb_sink += (uintptr_t)get_module_linear(c->names[(i * 7919) % c->n]);
+}
+
+void run_module_indexed(void* arg, int calls) {
+    LookupCtx* c = (LookupCtx*)arg;
+    for (int i = 0; i < calls; i++) mb_sink += (uintptr_t)get_module(c->names[(i * 7919) % c->n], false);
+}
+
+void run_module_interned(void* arg, int calls) {
+    LookupCtx* c = (LookupCtx*)arg;
+    for (int i = 0; i < calls; i++) mb_sink += (uintptr_t)ptr_map_get(&c->by_ptr, c->interned[(i * 7919) % c->n]);
+}
+
+void run_port_baseline(void* arg, int calls) {
+    LookupCtx* c = (LookupCtx*)arg;
+    for (int i = 0; i < calls; i++) mb_sink += (uintptr_t)get_port(c->mod, c->names[(i * 7919) % c->n], false);
+}
+
+void run_port_indexed(void* arg, int calls) {
+    LookupCtx* c = (LookupCtx*)arg;
+    for (int i = 0; i < calls; i++) mb_sink += (uintptr_t)port_index_get(&c->ports, c->names[(i * 7919) % c->n]);
+}
+
+void run_port_interned(void* arg, int calls) {
+    LookupCtx* c = (LookupCtx*)arg;
+    for (int i = 0; i < calls; i++) mb_sink += (uintptr_t)ptr_map_get(&c->by_ptr, c->interned[(i * 7919) % c->n]);
+}
+
+void mb_parse(int len) {
+    ParseCtx c;
+    c.n = 64;
+    c.args = xcalloc(c.n, sizeof(*c.args));
+    for (int i = 0; i < c.n; i++) {
+        char m[MAX_STR], p[MAX_STR];
+        mb_name(m, "Module", i, len);
+        mb_name(p, "port", i, len);
+        snprintf(c.args[i], sizeof(c.args[i]), i % 2 ? "%s::%s:float" : "%s::%s", m, p);
+    }
+    mb_time("parse_arg_safe", "baseline", c.n, len, run_parse_baseline, &c);
+    mb_time("parse_arg_safe", "onepass", c.n, len, run_parse_onepass, &c);
+    free(c.args);
+}
+
+// The key set is copied out of the model, so baseline and indexed
+// lookups compare real strings; 'interned' holds the model's own pointers
+void mb_lookup_keys(LookupCtx* c, int n) {
+    c->n = n;
+    c->names = xcalloc(n, sizeof(*c->names));
+    c->interned = (const char**)xcalloc(n, sizeof(char*));
+    ptr_map_init(&c->by_ptr, n);
+}
+
+void mb_lookup_free(LookupCtx* c) {
+    free(c->names);
+    free(c->interned);
+    ptr_map_free(&c->by_ptr);
+}
+
+void mb_modules(int n, int len) {
+    model_free();
+    LookupCtx c = { 0 };
+    mb_lookup_keys(&c, n);
+    for (int i = 0; i < n; i++) {
+        char name[MAX_STR];
+        mb_name(name, "Subsystem_", i, len);
+        Module* m = get_module(name, true);
+        strcpy(c.names[i], m->name);
+        c.interned[i] = m->name;
+        ptr_map_put(&c.by_ptr, m->name, m);
+    }
+    if (n <= 1024) mb_time("get_module", "linear", n, len, run_module_linear, &c); // O(n) per call
+    mb_time("get_module", "indexed", n, len, run_module_indexed, &c);
+    mb_time("get_module", "interned", n, len, run_module_interned, &c);
+    mb_lookup_free(&c);
+    model_free();
+}
+
+void mb_ports(int n, int len) {
+    model_free();
+    LookupCtx c = { 0 };
+    mb_lookup_keys(&c, n);
+    c.mod = get_module("Bench", true);
+    for (int i = 0; i < n; i++) {
+        char name[MAX_STR];
+        mb_name(name, "signal_", i, len);
+        Port* p = get_port(c.mod, name, true);
+        strcpy(c.names[i], p->name);
+        c.interned[i] = p->name;
+        ptr_map_put(&c.by_ptr, p->name, p);
+    }
+    port_index_build(&c.ports, c.mod, n);
+    mb_time("get_port", "baseline", n, len, run_port_baseline, &c);
+    mb_time("get_port", "indexed", n, len, run_port_indexed, &c);
+    mb_time("get_port", "interned", n, len, run_port_interned, &c);
+    free(c.ports.slots);
+    mb_lookup_free(&c);
+    model_free();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        printf("Usage: microbench\n");
+        printf("  Times str_to_dir, parse_arg_safe, get_module and get_port against\n");
+        printf("  indexed and interned variants; prints %s per call.\n", MB_UNIT);
+        return strcmp(argv[1], "-h") == 0 ? 0 : 1;
+    }
+    printf("%-14s %-9s %7s %5s %10s %10s\n", "primitive", "variant", "size", "len",
+           "median", "min");
+    printf("(%s per call; size = keys or table entries, len = name length)\n", MB_UNIT);
+
+    mb_time("str_to_dir", "baseline", 4, 3, run_dir_baseline, NULL);
+    mb_time("str_to_dir", "switch", 4, 3, run_dir_switch, NULL);
+
+    for (int l = 0; l < MB_COUNT(mb_name_lens); l++) mb_parse(mb_name_lens[l]);
+
+    for (int s = 0; s < MB_COUNT(mb_module_counts); s++)
+        for (int l = 0; l < MB_COUNT(mb_name_lens); l++) mb_modules(mb_module_counts[s], mb_name_lens[l]);
+
+    for (int s = 0; s < MB_COUNT(mb_port_counts); s++)
+        for (int l = 0; l < MB_COUNT(mb_name_lens); l++) mb_ports(mb_port_counts[s], mb_name_lens[l]);
+    return 0;
+}
@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""Compare a bench/bench run against the recorded baseline.
+
+Two checks run on every op:
+
+  median   the median time per model size must stay within the op's
+           tolerance of the baseline (times are machine-specific, so
+           record the baseline on the machine that runs the gate)
+  scaling  the growth from one model size to the next (10x more ports)
+           must not exceed the baseline's growth by more than
+           scaling_tolerance; this ratio is largely machine-independent
+           and is what catches a linear path turning quadratic
+
+An op/size in the results that the baseline lacks also fails the check:
+it would otherwise never be compared. Re-record the baseline together
+with any change that adds a bench op.
+
+Usage:
+  perf_check.py results.json baseline.json            compare, exit 1 on regression
+  perf_check.py --record results.json baseline.json   write results as the new baseline,
+                                                      keeping existing tolerances
+  perf_check.py --speedup base.json other.json...     print each run's speedup over base
+                                                      (used by 'make pgo')
+"""
+import json
+import sys
+
+DEFAULTS = {
+    "default_tolerance": 0.30,  # Allowed slowdown of a median, as a fraction
+    "scaling_tolerance": 0.50,  # Allowed growth of the size-to-size ratio
+    "min_size": 10000,          # Smaller models are too quick to time reliably
+    "min_seconds": 0.002,       # Medians below this are never flagged
+    "tolerances": {             # Per-op overrides for the noisier timings
+        "cmd_add": 0.50,
+        "cli_list": 0.50,
+        "cli_check": 0.50,
+        "get_module": 0.40,
+        "get_port": 0.40,
+    },
+}
+
+
+def load(path):
+    with open(path) as f:
+        return json.load(f)
+
+
+def op_name(r):
+    # Thread-sweep rows repeat an op once per pool size
+    return f"{r['op']}@{r['threads']}" if "threads" in r else r["op"]
+
+
+def medians(results, min_size):
+    out = {}
+    for r in results:
+        if r["size"] >= min_size:
+            out[(op_name(r), r["size"])] = r["median"]
+    return out
+
+
+def record(results_path, baseline_path):
+    results = load(results_path)
+    try:
+        base = load(baseline_path)
+    except FileNotFoundError:
+        base = {}
+    out = {"version": 1}
+    for key, value in DEFAULTS.items():
+        out[key] = base.get(key, value)
+    out["timestamp"] = results.get("timestamp")
+    out["threads"] = results.get("threads")
+    out["results"] = [
+        {"op": r["op"], **({"threads": r["threads"]} if "threads" in r else {}),
+         "size": r["size"], "median": r["median"]}
+        for r in results["results"]
+        if r["size"] >= out["min_size"]
+    ]
+    with open(baseline_path, "w") as f:
+        json.dump(out, f, indent=2)
+        f.write("\n")
+    print(f"Recorded {len(out['results'])} metrics to {baseline_path}")
+    return 0
+
+
+def fmt_s(s):
+    return f"{s * 1e3:10.3f}ms"
+
+
+def compare(results_path, baseline_path):
+    results = load(results_path)
+    base = load(baseline_path)
+    cfg = dict(DEFAULTS)
+    cfg.update({k: base[k] for k in DEFAULTS if k in base})
+
+    old = medians(base["results"], cfg["min_size"])
+    new = medians(results["results"], cfg["min_size"])
+    failures = []
+
+    print(f"{'op':<14} {'size':>8} {'baseline':>12} {'current':>12} {'change':>8} {'limit':>7}  status")
+    for (op, size), before in sorted(old.items()):
+        after = new.get((op, size))
+        if after is None:
+            print(f"{op:<14} {size:>8} {fmt_s(before)} {'missing':>12}")
+            failures.append(f"{op} at {size} ports: missing from results")
+            continue
+        tol = cfg["tolerances"].get(op.split("@")[0], cfg["default_tolerance"])
+        change = after / before - 1 if before > 0 else 0.0
+        status = "ok"
+        if change > tol and after >= cfg["min_seconds"]:
+            status = "REGRESSED"
+            failures.append(f"{op} at {size} ports: {fmt_s(before).strip()} -> {fmt_s(after).strip()} "
+                            f"({change:+.0%}, limit +{tol:.0%})")
+        elif change < -tol:
+            status = "faster"
+        print(f"{op:<14} {size:>8} {fmt_s(before)} {fmt_s(after)} {change:>+8.0%} {tol:>+7.0%}  {status}")
+    for op, size in sorted(set(new) - set(old)):
+        print(f"{op:<14} {size:>8} {'unrecorded':>12} {fmt_s(new[(op, size)])}")
+        failures.append(f"{op} at {size} ports: not in the baseline")
+
+    # Growth per size step, compared op by op
+    print(f"\n{'op':<14} {'sizes':>16} {'baseline':>9} {'current':>9} {'limit':>9}  status")
+    ops = sorted({op for op, _ in old})
+    for op in ops:
+        sizes = sorted(size for o, size in old if o == op and (o, size) in new)
+        for small, large in zip(sizes, sizes[1:]):
+            if old[(op, small)] < cfg["min_seconds"] or new[(op, small)] < cfg["min_seconds"]:
+                continue  # Ratios of tiny timings are mostly noise
+            before = old[(op, large)] / old[(op, small)]
+            after = new[(op, large)] / new[(op, small)]
+            limit = before * (1 + cfg["scaling_tolerance"])
+            status = "ok"
+            if after > limit:
+                status = "REGRESSED"
+                failures.append(f"{op} grows {after:.1f}x from {small} to {large} ports "
+                                f"(baseline {before:.1f}x, limit {limit:.1f}x)")
+            print(f"{op:<14} {f'{small}->{large}':>16} {before:>8.1f}x {after:>8.1f}x {limit:>8.1f}x  {status}")
+
+    if failures:
+        print(f"\nperf-check FAILED: {len(failures)} regression(s)")
+        for f in failures:
+            print(f"  {f}")
+        print("If the slowdown is expected, or ops were added, re-record with 'make perf-baseline'.")
+        return 1
+    print(f"\nperf-check passed: {len(old)} metrics within tolerance")
+    return 0
+
+
+def speedup(paths):
+    runs = [load(p)["results"] for p in paths]
+    base = medians(runs[0], 0)
+    others = [medians(r, 0) for r in runs[1:]]
+    names = [p.rsplit("/", 1)[-1].rsplit(".", 1)[0] for p in paths]
+
+    print(f"{'op':<14} {'size':>8} {names[0] + ' (ms)':>14}" + "".join(f" {n:>10}" for n in names[1:]))
+    for (op, size), before in sorted(base.items()):
+        cols = []
+        for o in others:
+            after = o.get((op, size))
+            cols.append(f"{before / after:>9.2f}x" if after else f"{'-':>10}")
+        print(f"{op:<14} {size:>8} {before * 1e3:>14.3f}" + "".join(f" {c}" for c in cols))
+    return 0
+
+
+def main(argv):
+    args = argv[1:]
+    if len(args) >= 3 and args[0] == "--speedup":
+        return speedup(args[1:])
+    if len(args) == 3 and args[0] == "--record":
+        return record(args[1], args[2])
+    if len(args) == 2:
+        return compare(args[0], args[1])
+    print(__doc__)
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,250 @@
+// Fuzz targets for the input parsers:
+//
+//   load_xml   load_xml_stream() over arbitrary bytes
+//   parse_arg  parse_arg_safe() over a Module::Port:Type argument
+//
+// Build one target per binary with -DFUZZ_TARGET_LOAD_XML or
+// -DFUZZ_TARGET_PARSE_ARG. With -DUSE_LIBFUZZER (clang -fsanitize=fuzzer)
+// libFuzzer supplies main(). Otherwise the standalone driver below runs
+// each seed once, then mutates seeds for a fixed time. Both paths report
+// executions per second, so parser speed and robustness are tracked
+// together. links has no binary model format, so there is no target for
+// one yet. See 'make fuzz' and 'make fuzz-libfuzzer'.
+
+#define main links_main
+#include "../src/links.c"
+#undef main
+
+#include <sanitizer/common_interface_defs.h>
+
+#define FUZZ_MAX_INPUT 65536
+
+#if defined(FUZZ_TARGET_LOAD_XML)
+#define FUZZ_NAME "load_xml"
+
+int fuzz_one(const uint8_t* data, size_t size) {
+    FILE* f = fmemopen((void*)data, size, "r");
+    if (!f) return 0;
+    load_xml_stream(f);
+    fclose(f);
+
+    // Everything loaded must still be a well-formed model
+    for (Module* m = root_modules; m; m = m->next) {
+        if (strlen(m->name) >= MAX_STR || get_module(m->name, false) == NULL) abort();
+        for (Port* p = m->ports; p; p = p->next)
+            if (strlen(p->name) >= MAX_STR || strlen(p->type) >= MAX_STR ||
+                strlen(p->dest_module) >= MAX_STR || strlen(p->dest_port) >= MAX_STR) abort();
+    }
+    model_free();
+    return 0;
+}
+
+static const char* fuzz_tokens[] = {
+    "<root>\n", "</root>\n", "  <module name=\"", "\" group=\"", "\">\n", "  </module>\n",
+    "    <port name=\"", "\" type=\"", "\" dir=\"", "in", "out", "none", "\" dest_mod=\"",
+    "\" dest_port=\"", "\" />\n", "\"", "\n",
+};
+
+#elif defined(FUZZ_TARGET_PARSE_ARG)
+#define FUZZ_NAME "parse_arg"
+
+int fuzz_one(const uint8_t* data, size_t size) {
+    char* input = (char*)malloc(size + 1);
+    if (!input) return 0;
+    memcpy(input, data, size);
+    input[size] = '\0';
+
+    char m[MAX_STR], p[MAX_STR], t[MAX_STR];
+    bool ok = parse_arg_safe(input, m, p, t);
+    if (strlen(m) >= MAX_STR || strlen(p) >= MAX_STR || strlen(t) >= MAX_STR) abort();
+    if (ok != (m[0] != '\0')) abort();
+    // The module name never swallows the separator
+    if (strstr(input, "::") && strstr(m, "::")) abort();
+    free(input);
+    return 0;
+}
+
+static const char* fuzz_tokens[] = { "::", ":", "Module", "Port", "float", "", "\xff" };
+
+#else
+#error "Define FUZZ_TARGET_LOAD_XML or FUZZ_TARGET_PARSE_ARG"
+#endif
+
+#define FUZZ_TOKENS (int)(sizeof(fuzz_tokens) / sizeof(fuzz_tokens[0]))
+
+#ifdef USE_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    return fuzz_one(data, size);
+}
+
+#else
+
+static uint8_t fuzz_buf[FUZZ_MAX_INPUT];
+static size_t fuzz_len = 0;
+static const char* crash_path = "fuzz/crash-" FUZZ_NAME;
+
+// Saves the input that tripped a sanitizer or an assertion
+void fuzz_save_input() {
+    int fd = open(crash_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+    ssize_t n = write(fd, fuzz_buf, fuzz_len);
+    (void)n;
+    close(fd);
+    const char msg[] = "fuzz: input saved to fuzz/crash-" FUZZ_NAME "\n";
+    n = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+}
+
+void fuzz_on_signal(int sig) {
+    fuzz_save_input();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+typedef struct {
+    uint8_t* data;
+    size_t len;
+} Seed;
+
+bool read_seed(const char* path, Seed* s) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    s->data = (uint8_t*)malloc(FUZZ_MAX_INPUT);
+    if (!s->data) { fclose(f); return false; }
+    s->len = fread(s->data, 1, FUZZ_MAX_INPUT, f);
+    fclose(f);
+    return true;
+}
+
+// Overwrites, inserts, deletes, dictionary tokens and splices, stacked
+void fuzz_mutate(uint64_t* rng, Seed* seeds, int n_seeds) {
+    int rounds = 1 + gen_below(rng, 8);
+    for (int r = 0; r < rounds; r++) {
+        size_t pos = fuzz_len ? (size_t)gen_below(rng, (int)fuzz_len + 1) : 0;
+        int op = gen_below(rng, 6);
+        switch (op) {
+        case 0: // Random byte
+            if (fuzz_len) fuzz_buf[pos % fuzz_len] = (uint8_t)gen_next(rng);
+            break;
+        case 1: // Bit flip
+            if (fuzz_len) fuzz_buf[pos % fuzz_len] ^= (uint8_t)(1u << gen_below(rng, 8));
+            break;
+        case 2: { // Delete a run
+            size_t n = 1 + gen_below(rng, 16);
+            if (pos + n > fuzz_len) n = fuzz_len - pos;
+            memmove(fuzz_buf + pos, fuzz_buf + pos + n, fuzz_len - pos - n);
+            fuzz_len -= n;
+            break;
+        }
+        case 3: // Insert a token
+        case 4: { // Repeat a byte, for long names and lines
+            const char* tok = fuzz_tokens[gen_below(rng, FUZZ_TOKENS)];
+            char rep[128];
+            if (op == 4) {
+                int n = 1 + gen_below(rng, (int)sizeof(rep) - 1);
+                memset(rep, fuzz_len ? fuzz_buf[pos % fuzz_len] : 'A', n);
+                rep[n] = '\0';
+                tok = rep;
+            }
+            size_t n = strlen(tok);
+            if (fuzz_len + n > FUZZ_MAX_INPUT) break;
+            memmove(fuzz_buf + pos + n, fuzz_buf + pos, fuzz_len - pos);
+            memcpy(fuzz_buf + pos, tok, n);
+            fuzz_len += n;
+            break;
+        }
+        default: { // Splice in part of another seed
+            Seed* s = &seeds[gen_below(rng, n_seeds)];
+            if (!s->len) break;
+            size_t from = gen_below(rng, (int)s->len);
+            size_t n = 1 + gen_below(rng, (int)(s->len - from));
+            if (fuzz_len + n > FUZZ_MAX_INPUT) break;
+            memmove(fuzz_buf + pos + n, fuzz_buf + pos, fuzz_len - pos);
+            memcpy(fuzz_buf + pos, s->data + from, n);
+            fuzz_len += n;
+        }
+        }
+    }
+}
+
+double fuzz_now() {
+    return prof_seconds(CLOCK_MONOTONIC);
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = 10;
+    uint64_t rng = 1;
+    Seed* seeds = NULL;
+    int n_seeds = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) rng = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-h") == 0) {
+            printf("Usage: fuzz_%s [-t seconds] [--seed N] corpus_dir_or_file...\n", FUZZ_NAME);
+            return 0;
+        } else {
+            // A directory contributes every file in it
+            DIR* d = opendir(argv[i]);
+            char path[4096];
+            struct dirent* de;
+            while (true) {
+                if (d) {
+                    de = readdir(d);
+                    if (!de) break;
+                    if (de->d_name[0] == '.') continue;
+                    snprintf(path, sizeof(path), "%s/%s", argv[i], de->d_name);
+                } else {
+                    snprintf(path, sizeof(path), "%s", argv[i]);
+                }
+                seeds = (Seed*)realloc(seeds, (n_seeds + 1) * sizeof(Seed));
+                if (!seeds) return 1;
+                if (read_seed(path, &seeds[n_seeds])) n_seeds++;
+                if (!d) break;
+            }
+            if (d) closedir(d);
+        }
+    }
+    if (n_seeds == 0) {
+        fprintf(stderr, "fuzz_%s: no seed inputs given\n", FUZZ_NAME);
+        return 1;
+    }
+
+    __sanitizer_set_death_callback(fuzz_save_input);
+    signal(SIGABRT, fuzz_on_signal);
+    signal(SIGSEGV, fuzz_on_signal);
+
+    // Every seed must pass as-is before mutating
+    double start = fuzz_now();
+    for (int i = 0; i < n_seeds; i++) {
+        fuzz_len = seeds[i].len;
+        memcpy(fuzz_buf, seeds[i].data, fuzz_len);
+        fuzz_one(fuzz_buf, fuzz_len);
+    }
+    double seed_time = fuzz_now() - start;
+
+    long execs = 0;
+    size_t bytes = 0;
+    start = fuzz_now();
+    double now = start;
+    while (now - start < seconds) {
+        Seed* s = &seeds[gen_below(&rng, n_seeds)];
+        fuzz_len = s->len;
+        memcpy(fuzz_buf, s->data, fuzz_len);
+        fuzz_mutate(&rng, seeds, n_seeds);
+        fuzz_one(fuzz_buf, fuzz_len);
+        execs++;
+        bytes += fuzz_len;
+        if ((execs & 255) == 0) now = fuzz_now();
+    }
+    now = fuzz_now();
+
+    printf("fuzz_%s: %d seeds in %.3fs, %ld mutated inputs in %.1fs: %.0f exec/s, %.1f MB/s, no failures\n",
+           FUZZ_NAME, n_seeds, seed_time, execs, now - start, execs / (now - start),
+           bytes / (now - start) / 1048576.0);
+    for (int i = 0; i < n_seeds; i++) free(seeds[i].data);
+    free(seeds);
+    return 0;
+}
+
+#endif
@@ -1,14 +1,31 @@
 import tkinter as tk
 from tkinter import ttk, simpledialog, messagebox
-import xml.etree.ElementTree as ET
 from collections import OrderedDict
 import subprocess
 import os
 import datetime
 import tempfile
+import threading
+import queue
+import signal
 
 temp_dir = "/home/ryder/.gemini/tmp/624f5738677a0804a93db48b0564719580210bf3caad456a7dc2520d76d651ce"
 
+RENDER_DEBOUNCE_MS = 300  # Edits closer together than this share one render
+RENDER_POLL_MS = 100      # How often the Tk thread checks for a finished render
+
+LINK_COLUMNS = ("src_mod", "src_port", "src_type", "dst_mod", "dst_port", "dst_type")
+LINK_HEADINGS = {
+    "src_mod": "Source Module", "src_port": "Source Port", "src_type": "Source Type",
+    "dst_mod": "Destination Module", "dst_port": "Destination Port", "dst_type": "Destination Type"
+}
+PAGE_ROWS = 500           # Rows fetched from 'links rows' per request
+MAX_CACHED_ROWS = 2000    # Cached rows are dropped beyond this
+WHEEL_ROWS = 3            # Rows scrolled per mouse wheel step
+FILTER_DEBOUNCE_MS = 300
+DEFAULT_ROW_HEIGHT = 20   # Treeview row height when the theme does not set one
+TREE_HEADER_PX = 25
+
 def log_message(message):
     timestamp = datetime.datetime.now().strftime("%Y-%m-%d %H:%M:%S")
     with open(os.path.join(temp_dir, "debug.log"), "a") as f:
@@ -51,8 +68,25 @@ class LinkEditor(tk.Tk):
 
         self.tree = None
         self.links = []
-        self.xml_file = "links_data.xml"
-        self.port_map = {}
+        self.link_by_src = {}   # (module, port) -> visible link from that port
+        self.links_by_dst = {}  # (module, port) -> visible links reading from that port
+
+        # Virtual list state: the backend holds the table, the GUI a window of it
+        self.total_rows = 0
+        self.view_offset = 0
+        self.visible_rows = 20
+        self.row_cache = {}     # Row index -> fields, a few pages around the view
+        self.sort_col = None
+        self.sort_desc = False
+        self.filter_text = ""
+        self.filter_after_id = None
+
+        # Background graph rendering (see refresh_graph)
+        self.render_generation = 0
+        self.render_after_id = None
+        self.render_proc = None
+        self.render_polling = False
+        self.render_results = queue.Queue()
 
         self.create_widgets()
         self.load_links()
@@ -78,19 +112,75 @@ class LinkEditor(tk.Tk):
         self.graph_image = None # Keep a reference
 
     def refresh_graph(self):
-        log_message("--- refresh_graph started ---")
+        # Rendering runs in the background: coalesce bursts of edits into one
+        # render once they settle, and drop any render the edit made stale
+        self.render_generation += 1
+        self._cancel_render()
+        if self.render_after_id is not None:
+            self.after_cancel(self.render_after_id)
+        self.render_after_id = self.after(RENDER_DEBOUNCE_MS, self._start_render)
+
+    def _start_render(self):
+        self.render_after_id = None
+        generation = self.render_generation
+        log_message(f"--- render {generation} started: ./links dot --formats png ---")
         try:
-            log_message("Executing: ./links dot")
-            result = subprocess.run(["./links", "dot"], check=True, capture_output=True, text=True)
-            log_message(f"Command stdout: {result.stdout.strip()}")
-            log_message(f"Command stderr: {result.stderr.strip()}")
-            log_message("Graph generation command completed successfully.")
-        except (subprocess.CalledProcessError, FileNotFoundError) as e:
-            errmsg = e.stderr if hasattr(e, 'stderr') and e.stderr else str(e)
+            # A session of its own, so cancelling also stops the Graphviz child
+            proc = subprocess.Popen(["./links", "dot", "--formats", "png"], stdout=subprocess.PIPE,
+                                    stderr=subprocess.PIPE, text=True, start_new_session=True)
+        except OSError as e:
+            log_message(f"Error generating graph: {e}")
+            messagebox.showerror("Error", f"Failed to generate graph:\n{e}")
+            return
+        self.render_proc = proc
+        self.graph_window.title("Link Graph (rendering...)")
+        threading.Thread(target=self._render_worker, args=(proc, generation), daemon=True).start()
+        if not self.render_polling:
+            self.render_polling = True
+            self.after(RENDER_POLL_MS, self._poll_render)
+
+    def _render_worker(self, proc, generation):
+        # Worker thread: never touches Tk, only hands the result back
+        stdout, stderr = proc.communicate()
+        self.render_results.put((generation, proc.returncode, stdout, stderr))
+
+    def _cancel_render(self):
+        proc = self.render_proc
+        if proc is not None and proc.poll() is None:
+            log_message(f"Cancelling stale render (pid {proc.pid})")
+            try:
+                os.killpg(proc.pid, signal.SIGTERM)
+            except ProcessLookupError:
+                pass
+        self.render_proc = None
+
+    def _poll_render(self):
+        while True:
+            try:
+                generation, returncode, stdout, stderr = self.render_results.get_nowait()
+            except queue.Empty:
+                break
+            if generation != self.render_generation:
+                log_message(f"Discarding stale render {generation} (current {self.render_generation})")
+                continue
+            self._show_graph(returncode, stdout, stderr)
+        if self.render_proc is not None or not self.render_results.empty():
+            self.after(RENDER_POLL_MS, self._poll_render)
+        else:
+            self.render_polling = False
+
+    def _show_graph(self, returncode, stdout, stderr):
+        self.render_proc = None
+        self.graph_window.title("Link Graph")
+        log_message(f"Command stdout: {stdout.strip()}")
+        log_message(f"Command stderr: {stderr.strip()}")
+        # links reports its errors on stdout
+        if returncode != 0 or "Error:" in stdout:
+            errmsg = stderr or stdout or f"./links dot exited with status {returncode}"
             log_message(f"Error generating graph: {errmsg}")
             messagebox.showerror("Error", f"Failed to generate graph:\n{errmsg}")
             return
-           
+
         try:
             # Ensure the image file actually exists and is not empty before loading
             if not os.path.exists("graph.png") or os.path.getsize("graph.png") == 0:
@@ -109,32 +199,43 @@ class LinkEditor(tk.Tk):
         except tk.TclError as e:
             log_message(f"Failed to load graph image: {e}")
             messagebox.showerror("Error", f"Failed to load graph image: {e}")
-        log_message("--- refresh_graph finished ---")
+        log_message("--- render finished ---")
 
     def create_widgets(self):
+        filter_frame = ttk.Frame(self, padding=(10, 10, 10, 0))
+        filter_frame.pack(fill="x")
+        ttk.Label(filter_frame, text="Filter:").pack(side="left")
+        self.filter_var = tk.StringVar()
+        self.filter_var.trace_add("write", self._on_filter_changed)
+        filter_entry = ttk.Entry(filter_frame, textvariable=self.filter_var, width=40)
+        filter_entry.pack(side="left", padx=5)
+        ToolTip(filter_entry, "Show only links with this text in any column")
+
         main_frame = ttk.Frame(self, padding="10")
         main_frame.pack(fill="both", expand=True)
 
-        # Treeview
-        columns = ("src_mod", "src_port", "src_type", "dst_mod", "dst_port", "dst_type")
-        self.tree = ttk.Treeview(main_frame, columns=columns, show="headings")
+        # Treeview: holds only the rows on screen, see render_window()
+        self.tree = ttk.Treeview(main_frame, columns=LINK_COLUMNS, show="headings")
         
-        headings = {
-            "src_mod": "Source Module", "src_port": "Source Port", "src_type": "Source Type",
-            "dst_mod": "Destination Module", "dst_port": "Destination Port", "dst_type": "Destination Type"
-        }
-        for col, heading in headings.items():
-            self.tree.heading(col, text=heading)
+        for col in LINK_COLUMNS:
+            self.tree.heading(col, text=LINK_HEADINGS[col], command=lambda c=col: self.sort_by(c))
             self.tree.column(col, width=150)
             
         self.tree.pack(side="left", fill="both", expand=True)
         self.tree.bind("<Delete>", lambda e: self.delete_link())
         self.tree.bind("<Double-1>", self.on_tree_double_click) # Bind double-click for in-place editing
-
-        # Scrollbar
-        scrollbar = ttk.Scrollbar(main_frame, orient="vertical", command=self.tree.yview)
-        scrollbar.pack(side="right", fill="y")
-        self.tree.configure(yscrollcommand=scrollbar.set)
+        self.tree.bind("<Configure>", self._on_tree_resize)
+        self.tree.bind("<MouseWheel>", self._on_mousewheel)
+        self.tree.bind("<Button-4>", self._on_mousewheel)
+        self.tree.bind("<Button-5>", self._on_mousewheel)
+        self.tree.bind("<Up>", lambda e: self._on_arrow(-1))
+        self.tree.bind("<Down>", lambda e: self._on_arrow(1))
+        self.tree.bind("<Prior>", lambda e: self.scroll_rows(-self.visible_rows))
+        self.tree.bind("<Next>", lambda e: self.scroll_rows(self.visible_rows))
+
+        # Scrollbar: spans the whole table, not just the rows in the Treeview
+        self.scrollbar = ttk.Scrollbar(main_frame, orient="vertical", command=self.on_scrollbar)
+        self.scrollbar.pack(side="right", fill="y")
 
         # Button frame
         button_frame = ttk.Frame(self, padding=(0, 10))
@@ -157,49 +258,223 @@ class LinkEditor(tk.Tk):
         self.bind_all("<Control-s>", lambda e: self.save_links())
 
     def load_links(self):
-        for item in self.tree.get_children():
-            self.tree.delete(item)
+        # The model stays in the backend: drop the cached rows and fetch the
+        # visible window again
+        self.row_cache.clear()
+        self.render_window()
+
+    def fetch_rows(self, offset, limit, find=None):
+        # One window of the filtered, sorted link table from 'links rows'.
+        # Returns the row index of 'find' (-1 if it is not in the table).
+        cmd = ["./links", "rows", "--offset", str(max(0, offset)), "--limit", str(limit)]
+        if self.sort_col:
+            cmd += ["--sort", self.sort_col]
+        if self.sort_desc:
+            cmd.append("--desc")
+        if self.filter_text:
+            cmd += ["--filter", self.filter_text]
+        if find:
+            cmd += ["--find", find]
+        try:
+            result = subprocess.run(cmd, check=True, capture_output=True, text=True)
+        except (subprocess.CalledProcessError, FileNotFoundError) as e:
+            errmsg = e.stderr if hasattr(e, 'stderr') and e.stderr else str(e)
+            log_message(f"Error fetching rows: {errmsg}")
+            messagebox.showerror("Error", f"Failed to load links:\n{errmsg}")
+            return None
+
+        # Memory follows the viewport: keep a few pages at most
+        if len(self.row_cache) + limit > MAX_CACHED_ROWS:
+            self.row_cache.clear()
+        found = None
+        for line in result.stdout.splitlines():
+            fields = line.split("\t")
+            if fields[0] == "row" and len(fields) == 2 + len(LINK_COLUMNS):
+                self.row_cache[int(fields[1])] = fields[2:]
+            elif fields[0] == "total":
+                self.total_rows = int(fields[1])
+            elif fields[0] == "found":
+                found = int(fields[1])
+            elif line.startswith("Error"):
+                log_message(f"Error fetching rows: {line}")
+                messagebox.showerror("Error", f"Failed to load links:\n{line}")
+        log_message(f"fetch_rows: {' '.join(cmd[1:])} -> {self.total_rows} rows in table")
+        return found
+
+    def render_window(self):
+        # Show rows view_offset .. view_offset + visible_rows, fetching the
+        # page around them when they are not cached
+        self.view_offset = max(0, min(self.view_offset, self.total_rows - self.visible_rows))
+        end = min(self.view_offset + self.visible_rows, self.total_rows)
+        missing = [i for i in range(self.view_offset, end) if i not in self.row_cache]
+        if missing or not self.row_cache:
+            # Read ahead in the direction of scrolling
+            if missing and missing[0] > self.view_offset:
+                start = self.view_offset
+            elif missing and missing[-1] < end - 1:
+                start = end - PAGE_ROWS
+            else:
+                start = self.view_offset - (PAGE_ROWS - self.visible_rows) // 2
+            self.fetch_rows(start, PAGE_ROWS)
+            self.view_offset = max(0, min(self.view_offset, self.total_rows - self.visible_rows))
+            end = min(self.view_offset + self.visible_rows, self.total_rows)
+
+        focused = self.tree.focus()
+        self.tree.delete(*self.tree.get_children())
         self.links.clear()
-        self.port_map.clear()
-        self.next_link_id = 0 # Initialize unique ID counter
+        self.link_by_src.clear()
+        self.links_by_dst.clear()
+        for index in range(self.view_offset, end):
+            fields = self.row_cache.get(index)
+            if fields is not None:
+                self._insert_link(index, fields)
+        if focused and self.tree.exists(focused):
+            self.tree.selection_set(focused)
+            self.tree.focus(focused)
+
+        if self.total_rows:
+            self.scrollbar.set(self.view_offset / self.total_rows, end / self.total_rows)
+        else:
+            self.scrollbar.set(0, 1)
+
+    def _insert_link(self, index, fields):
+        link_data = OrderedDict(zip(LINK_COLUMNS, fields))
+        link_data["unique_id"] = index # Row index in the table, also the Treeview iid
+        self.links.append(link_data)
+        self.link_by_src[(link_data["src_mod"], link_data["src_port"])] = link_data
+        self.links_by_dst.setdefault((link_data["dst_mod"], link_data["dst_port"]), []).append(link_data)
+        new_iid = str(index)
+        self.tree.insert("", "end", values=fields, iid=new_iid, tags=(new_iid,))
+        return link_data
+
+    def show_link(self, src_mod, src_port):
+        # Scrolls the link from src_mod::src_port into view and selects it.
+        # Returns its Treeview iid, or "" when it is not in the table.
+        self.row_cache.clear()
+        found = self.fetch_rows(self.view_offset, PAGE_ROWS, find=f"{src_mod}::{src_port}")
+        if found is None or found < 0:
+            self.render_window()
+            return ""
+        self.view_offset = found - self.visible_rows // 2
+        self.render_window()
+        iid = str(found)
+        if not self.tree.exists(iid):
+            return ""
+        self.tree.selection_set(iid)
+        self.tree.focus(iid)
+        return iid
+
+    def scroll_rows(self, delta):
+        self.view_offset += delta
+        self.render_window()
+        return "break"
+
+    def on_scrollbar(self, *args):
+        if args[0] == "moveto":
+            self.view_offset = int(float(args[1]) * self.total_rows)
+        elif args[0] == "scroll":
+            step = self.visible_rows if args[2] == "pages" else 1
+            self.view_offset += int(args[1]) * step
+        self.render_window()
+
+    def _on_mousewheel(self, event):
+        if event.num == 4 or getattr(event, "delta", 0) > 0:
+            return self.scroll_rows(-WHEEL_ROWS)
+        return self.scroll_rows(WHEEL_ROWS)
+
+    def _on_arrow(self, step):
+        # Within the window the Treeview moves the focus itself; at its
+        # edge the window scrolls under a focus that stays on the edge row
+        children = self.tree.get_children()
+        if not children or self.tree.focus() != children[-1 if step > 0 else 0]:
+            return None
+        self.scroll_rows(step)
+        children = self.tree.get_children()
+        if children:
+            edge = children[-1 if step > 0 else 0]
+            self.tree.selection_set(edge)
+            self.tree.focus(edge)
+        return "break"
+
+    def _on_tree_resize(self, event):
+        rowheight = int(ttk.Style().lookup("Treeview", "rowheight") or DEFAULT_ROW_HEIGHT)
+        rows = max(1, (event.height - TREE_HEADER_PX) // rowheight)
+        if rows != self.visible_rows:
+            self.visible_rows = rows
+            self.render_window()
+
+    def sort_by(self, column):
+        # Sorting happens in the backend, over the whole table
+        if self.sort_col == column:
+            self.sort_desc = not self.sort_desc
+        else:
+            self.sort_col, self.sort_desc = column, False
+        for col in LINK_COLUMNS:
+            arrow = (" ▼" if self.sort_desc else " ▲") if col == self.sort_col else ""
+            self.tree.heading(col, text=LINK_HEADINGS[col] + arrow)
+        self.view_offset = 0
+        self.load_links()
 
+    def _on_filter_changed(self, *args):
+        if self.filter_after_id is not None:
+            self.after_cancel(self.filter_after_id)
+        self.filter_after_id = self.after(FILTER_DEBOUNCE_MS, self._apply_filter)
 
-        try:
-            xml_tree = ET.parse(self.xml_file)
-            self.complete_xml_root = xml_tree.getroot() # Store the complete XML root
-            root = self.complete_xml_root # Use this root for populating links
-
-            for module in root.findall("module"):
-                module_name = module.get("name")
-                for port in module.findall("port"):
-                    port_name = port.get("name")
-                    self.port_map[(module_name, port_name)] = port.get("type")
-
-            for module in root.findall("module"):
-                src_mod_name = module.get("name")
-                for port in module.findall("port"):
-                    if port.get("dir") == "out" and port.get("dest_mod") and port.get("dest_port"):
-                        link_data = OrderedDict([
-                            ("src_mod", src_mod_name),
-                            ("src_port", port.get("name")),
-                            ("src_type", port.get("type")),
-                            ("dst_mod", port.get("dest_mod")),
-                            ("dst_port", port.get("dest_port")),
-                            ("dst_type", self.port_map.get((port.get("dest_mod"), port.get("dest_port")))),
-                            ("unique_id", self.next_link_id) # Assign unique ID
-                        ])
-                        self.links.append(link_data)
-                        new_iid = str(self.next_link_id)
-                        self.tree.insert("", "end", values=list(link_data.values())[:6], iid=new_iid, tags=(new_iid,))
-                        log_message(f"load_links: Added link unique_id={self.next_link_id}, Treeview iid={new_iid}, data={link_data}")
-                        self.next_link_id += 1
-        except (FileNotFoundError, ET.ParseError) as e:
-            messagebox.showerror("Error", f"Failed to load {self.xml_file}: {e}")
+    def _apply_filter(self):
+        self.filter_after_id = None
+        self.filter_text = self.filter_var.get()
+        self.view_offset = 0
+        self.load_links()
+
+    def apply_events(self, output):
+        # Patch the visible rows touched by the ports that 'links --events'
+        # reports. When a change can alter which links exist or where they
+        # sort, re-fetch just the visible window instead.
+        count = 0
+        refetch = bool(self.sort_col or self.filter_text)
+        for line in output.splitlines():
+            fields = line.split("\t")
+            if len(fields) != 8 or fields[0] != "event":
+                continue
+            _, kind, mod, port, ptype, pdir, dest_mod, dest_port = fields
+            if self._apply_port_event(mod, port, ptype, pdir, dest_mod, dest_port):
+                refetch = True
+            count += 1
+        log_message(f"apply_events: patched the view from {count} port event(s), refetch={refetch}")
+        if refetch:
+            self.load_links()
+
+    def _apply_port_event(self, mod, port, ptype, pdir, dest_mod, dest_port):
+        # Returns True when the visible rows alone cannot show the change
+        key = (mod, port)
+        link_data = self.link_by_src.get(key)
+        stale = False
+        if link_data is None or pdir != "out" or (link_data["dst_mod"], link_data["dst_port"]) != (dest_mod, dest_port):
+            # A link appeared, went away or moved, or the port is off screen
+            stale = True
+        else:
+            link_data["src_type"] = ptype
+            self.tree.item(str(link_data["unique_id"]), values=list(link_data.values())[:6])
+
+        # render_window() redraws from the cache, so patch it too: this row,
+        # and every cached link into this port, on screen or not
+        for fields in self.row_cache.values():
+            if (fields[0], fields[1]) == key and not stale:
+                fields[2] = ptype
+            if (fields[3], fields[4]) == key:
+                fields[5] = ptype
+
+        # Links into this port show its type as their destination type
+        for reader in self.links_by_dst.get(key, []):
+            reader["dst_type"] = ptype
+            self.tree.item(str(reader["unique_id"]), values=list(reader.values())[:6])
+        return stale
 
     def add_link(self):
         log_message("--- add_link started ---")
         selected_item = self.tree.focus()
         log_message(f"selected_item: {selected_item}")
+        added = False
 
         initial_link_data = OrderedDict([
             ("src_mod", ""),
@@ -240,7 +515,7 @@ class LinkEditor(tk.Tk):
                     # Clear dst_type as it's usually derived
                     initial_link_data["dst_type"] = ""
                     # Make the new link distinct by modifying its source port
-                    initial_link_data["src_port"] = f"{initial_link_data['src_port']}_copy{self.next_link_id}"
+                    initial_link_data["src_port"] = f"{initial_link_data['src_port']}_copy{self.total_rows}"
 
         
         try:
@@ -251,7 +526,7 @@ class LinkEditor(tk.Tk):
             dst_str = f"{initial_link_data['dst_mod']}::{initial_link_data['dst_port']}"
 
             log_message(f"Executing links add command: ./links add \"{src_str}\" \"{dst_str}\"")
-            result = subprocess.run(["./links", "add", src_str, dst_str], check=True, capture_output=True, text=True)
+            result = subprocess.run(["./links", "--events", "add", src_str, dst_str], check=True, capture_output=True, text=True)
             log_message(f"links add stdout: {result.stdout.strip()}")
             log_message(f"links add stderr: {result.stderr.strip()}")
             
@@ -260,13 +535,9 @@ class LinkEditor(tk.Tk):
             else:
                 raise subprocess.CalledProcessError(result.returncode, result.args, output=result.stdout, stderr=result.stderr)
 
-            # After adding via external command, reload links and refresh graph
-            # The newly added link's unique_id will be re-assigned during load_links()
-            self.load_links()
+            self.apply_events(result.stdout)
             self.refresh_graph()
-
-            # The selection logic after save_links() should now correctly find the newly added item.
-            # It will be the one with the src_port containing _copyX and the latest unique_id.
+            added = True
 
         except subprocess.CalledProcessError as e:
             errmsg = e.stderr if hasattr(e, 'stderr') and e.stderr else str(e)
@@ -275,37 +546,12 @@ class LinkEditor(tk.Tk):
         
         log_message(f"initial_link_data after update: {initial_link_data}") # Keep for debugging previous state
 
-        # The following block is the new selection logic, already correctly logging.
-        # It needs to be outside the try-except to execute even if initial_link_data construction fails.
-
-        # Save and refresh the entire structure. This will rebuild self.links and self.tree
-        # and assign new, correct iids for all items.
-        # self.save_links() # No longer needed here, add_link directly calls load_links/refresh_graph
-
-        # After save_links(), the Treeview is reloaded. We need to find the newly added item.
-        # The new item will be the last one in the tree, or we can look for it by content.
-        # A simpler way is to re-select the last added link (which would be at index len(self.links)-1)
-        # assuming no other changes occurred in between which might reorder self.links.
-        # This implicitly assumes that the order is preserved, which load_links does.
-        if len(self.links) > 0:
-            # Find the item in the treeview that corresponds to the newly added link's unique_id
-            # The newly added link should be the last one in self.links after save_links() reloads.
-            newly_added_link_unique_id = str(self.links[-1]["unique_id"])
-            log_message(f"add_link selection: Targeting newly_added_link_unique_id={newly_added_link_unique_id}")
-            re_identified_item_id = ""
-            for child_item_id in self.tree.get_children():
-                item_tags_for_child = self.tree.item(child_item_id, 'tags')
-                log_message(f"add_link selection: Checking child_item_id={child_item_id}, tags={item_tags_for_child}")
-                if newly_added_link_unique_id in item_tags_for_child:
-                    re_identified_item_id = child_item_id
-                    log_message(f"add_link selection: Matched re_identified_item_id={re_identified_item_id}")
-                    break
-
+        # The new link can be anywhere in the sorted, filtered table: ask the
+        # backend for its row and scroll there
+        if added:
+            re_identified_item_id = self.show_link(initial_link_data["src_mod"], initial_link_data["src_port"])
             if re_identified_item_id:
-                # Scroll to and select the new item
                 self.tree.see(re_identified_item_id)
-                self.tree.selection_set(re_identified_item_id)
-                self.tree.focus(re_identified_item_id)
                 log_message(f"add_link selection: Successfully selected and focused on {re_identified_item_id}")
 
                 # Trigger in-place edit for the first column of the new row
@@ -316,7 +562,7 @@ class LinkEditor(tk.Tk):
                     event = type('Event', (object,), {'x': x_coord, 'y': y_coord})()
                     self.on_tree_double_click(event)
             else:
-                log_message(f"Could not re-identify newly added item with unique_id: {newly_added_link_unique_id}")
+                log_message("Could not find the newly added link (hidden by the filter?)")
 
         log_message("--- add_link finished ---")
 
@@ -352,7 +598,7 @@ class LinkEditor(tk.Tk):
                 dst_str = f"{link_to_delete['dst_mod']}::{link_to_delete['dst_port']}"
 
                 log_message(f"Executing links remove command: ./links remove \"{src_str}\" \"{dst_str}\"")
-                result = subprocess.run(["./links", "remove", src_str, dst_str], check=True, capture_output=True, text=True)
+                result = subprocess.run(["./links", "--events", "remove", src_str, dst_str], check=True, capture_output=True, text=True)
                 log_message(f"links remove stdout: {result.stdout.strip()}")
                 log_message(f"links remove stderr: {result.stderr.strip()}")
 
@@ -361,7 +607,7 @@ class LinkEditor(tk.Tk):
                 else:
                     raise subprocess.CalledProcessError(result.returncode, result.args, output=result.stdout, stderr=result.stderr)
                 
-                self.load_links()
+                self.apply_events(result.stdout)
                 self.refresh_graph()
             except subprocess.CalledProcessError as e:
                 errmsg = e.stderr if hasattr(e, 'stderr') and e.stderr else str(e)
@@ -381,6 +627,19 @@ class LinkEditor(tk.Tk):
             messagebox.showerror("Error", f"Failed to refresh view from XML: {e}")
         log_message("--- save_links finished ---")
 
+    def run_links_change(self, args):
+        # Runs one model change as a single links command (one load, one
+        # save) and returns its result; its change events are on stdout
+        cmd = ["./links", "--events"] + args
+        log_message(f"Executing links command: {' '.join(cmd)}")
+        result = subprocess.run(cmd, check=True, capture_output=True, text=True)
+        log_message(f"links stdout: {result.stdout.strip()}")
+        log_message(f"links stderr: {result.stderr.strip()}")
+        # links reports its errors on stdout
+        if "Error:" in result.stdout or "Link not found" in result.stdout:
+            raise subprocess.CalledProcessError(result.returncode, result.args, output=result.stdout, stderr=result.stdout)
+        return result
+
     def on_tree_double_click(self, event):
         region = self.tree.identify_region(event.x, event.y)
         if region != "cell":
@@ -452,86 +711,36 @@ class LinkEditor(tk.Tk):
                         src_mod = link_to_edit['src_mod']
                         src_port = link_to_edit['src_port']
                         
-                        cmd = ["./links", "edit", f"{src_mod}::{src_port}", new_value, "out"] # Assume 'out' direction for src_type
-                        log_message(f"Executing links edit command: {' '.join(cmd)}")
-                        result = subprocess.run(cmd, check=True, capture_output=True, text=True)
-                        log_message(f"links edit stdout: {result.stdout.strip()}")
-                        log_message(f"links edit stderr: {result.stderr.strip()}")
-                        
-                        if result.returncode == 0:
-                            messagebox.showinfo("Success", "Source type updated successfully.")
-                            # After editing, reload links and refresh graph
-                            self.load_links()
-                            self.refresh_graph()
-                        else:
-                            raise subprocess.CalledProcessError(result.returncode, result.args, output=result.stdout, stderr=result.stderr)
+                        result = self.run_links_change(["set", f"{src_mod}::{src_port}", f"type={new_value}"])
+                        messagebox.showinfo("Success", "Source type updated successfully.")
+                        # After editing, patch the affected rows and refresh graph
+                        self.apply_events(result.stdout)
+                        self.refresh_graph()
                     else:
                         log_message(f"No change in src_type for {link_to_edit['src_mod']}::{link_to_edit['src_port']}. No action.")
                 elif column_name in ["src_mod", "src_port", "dst_mod", "dst_port"]:
                     if new_value != current_value:
-                        # Store old link details for removal
-                        src_str_old = f"{link_to_edit['src_mod']}::{link_to_edit['src_port']}:{link_to_edit['src_type']}"
-                        dst_str_old = f"{link_to_edit['dst_mod']}::{link_to_edit['dst_port']}"
-                        
-                        # Create a temporary dictionary for the new link data
-                        # This ensures src_type is always included for 'add' command
                         updated_link_temp = link_to_edit.copy()
                         updated_link_temp[column_name] = new_value
 
-                        # Construct new link details for adding
-                        src_str_new = f"{updated_link_temp['src_mod']}::{updated_link_temp['src_port']}:{updated_link_temp['src_type']}"
-                        dst_str_new = f"{updated_link_temp['dst_mod']}::{updated_link_temp['dst_port']}"
-
-                        # Execute remove and add commands
-                        remove_cmd = ["./links", "remove", src_str_old, dst_str_old]
-                        log_message(f"Executing links remove command (for in-place edit): {' '.join(remove_cmd)}")
-                        subprocess.run(remove_cmd, check=True, capture_output=True, text=True)
-
-                        add_cmd = ["./links", "add", src_str_new, dst_str_new]
-                        log_message(f"Executing links add command (for in-place edit): {' '.join(add_cmd)}")
-                        subprocess.run(add_cmd, check=True, capture_output=True, text=True)
+                        src_old = f"{link_to_edit['src_mod']}::{link_to_edit['src_port']}"
+                        dst_old = f"{link_to_edit['dst_mod']}::{link_to_edit['dst_port']}"
+                        dst_new = f"{updated_link_temp['dst_mod']}::{updated_link_temp['dst_port']}"
+                        if column_name in ("dst_mod", "dst_port"):
+                            args = ["relink", src_old, dst_old, dst_new]
+                        else:
+                            # A new source: unlink the old port and link the new one in the same run
+                            src_new = f"{updated_link_temp['src_mod']}::{updated_link_temp['src_port']}:{updated_link_temp['src_type']}"
+                            args = ["set", src_old, "dir=none", src_new, f"dest={dst_new}"]
+                        result = self.run_links_change(args)
                         
                         messagebox.showinfo("Success", f"{column_name.replace('_', ' ').title()} updated successfully.")
-                        self.load_links()
+                        self.apply_events(result.stdout)
                         self.refresh_graph()
-                        # Store expected_new_link for re-selection (next TODO)
-                        self.expected_new_link_data = updated_link_temp.copy()
-                        # Remove unique_id, xml_port_element as they will be re-assigned
-                        self.expected_new_link_data.pop("unique_id", None)
-                        
-                        # --- Re-selection logic ---
-                        re_selected = False
-                        if hasattr(self, 'expected_new_link_data') and self.expected_new_link_data:
-                            found_unique_id = None
-                            for link_dict_after_load in self.links:
-                                match = True
-                                for key in ["src_mod", "src_port", "src_type", "dst_mod", "dst_port"]:
-                                    if link_dict_after_load.get(key) != self.expected_new_link_data.get(key):
-                                        match = False
-                                        break
-                                if match:
-                                    found_unique_id = str(link_dict_after_load["unique_id"])
-                                    break
-                            
-                            if found_unique_id:
-                                re_identified_item_id = ""
-                                for child_item_id in self.tree.get_children():
-                                    item_tags_for_child = self.tree.item(child_item_id, 'tags')
-                                    if found_unique_id in item_tags_for_child:
-                                        re_identified_item_id = child_item_id
-                                        break
-                                if re_identified_item_id:
-                                    self.tree.see(re_identified_item_id)
-                                    self.tree.selection_set(re_identified_item_id)
-                                    self.tree.focus(re_identified_item_id)
-                                    re_selected = True
-                                    log_message(f"Re-selected item: {re_identified_item_id} with unique_id: {found_unique_id}")
-                            
-                            del self.expected_new_link_data # Clear after use
-                        
+                        # The edited link may have moved in the sorted table
+                        re_selected = bool(self.show_link(updated_link_temp["src_mod"], updated_link_temp["src_port"]))
                         if not re_selected:
                             log_message("Failed to re-select item after in-place edit.")
-                        # --- End re-selection logic ---
 
                     else:
                         log_message(f"No change in {column_name} for {link_to_edit['src_mod']}::{link_to_edit['src_port']}. No action.")
@@ -564,3 +773,4 @@ class LinkEditor(tk.Tk):
 if __name__ == "__main__":
     app = LinkEditor()
     app.mainloop()
+    app._cancel_render()
@@ -1,10 +1,41 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // syscall() for perf_event_open
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#ifdef __GLIBC__ // Defined by the libc headers above; malloc.h is glibc-only
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 #define MAX_STR 64
 #define FILE_NAME "links_data.xml"
+#define MAX_THREADS 256
+#define MAX_FORMATS 8
+#define DEFAULT_FORMATS "svg,png"
+#define CACHE_DIR ".links-cache"
+#define CACHE_MAX_FILES 64
+#define LAYOUT_FILE "graph.layout"
+
+extern char** environ;
 
 // --- Data Structures ---
 
@@ -21,14 +52,349 @@ typedef struct Port {
 
 typedef struct Module {
     char name[MAX_STR];
+    char group[MAX_STR];    // Optional cluster name for 'dot --cluster group'
     Port* ports;
+    int idx;                // Creation order; modules are never deleted
     struct Module* next;
 } Module;
 
 Module* root_modules = NULL;
+Module* last_module = NULL;
+int module_count = 0;
+
+// Open-addressing hash index over module names (power-of-two capacity)
+Module** module_table = NULL;
+size_t module_table_cap = 0;
+
+// --- Profiling ---
+
+// '--profile' times the phases of a run and counts the work done in them.
+// Counters are only touched while profiling is on, so a normal run pays
+// one predictable branch per allocation or lookup.
+
+typedef enum { PHASE_LOAD, PHASE_COMMAND, PHASE_SAVE, PHASE_GRAPHVIZ, PHASE_COUNT } Phase;
+
+static const char* phase_names[PHASE_COUNT] = { "load", "command", "save", "graphviz" };
+
+// Hardware counters for '--perf-counters', read around the same phases
+enum { HW_CYCLES, HW_INSTRUCTIONS, HW_CACHE_MISSES, HW_BRANCH_MISSES, HW_COUNT };
+
+static const char* hw_names[HW_COUNT] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+typedef struct {
+    bool enabled;
+    const char* json_path;  // Write JSON here instead of the stderr table
+    double wall[PHASE_COUNT];
+    double cpu[PHASE_COUNT];  // This process plus waited-for children
+    int calls[PHASE_COUNT];
+    atomic_long mallocs;
+    atomic_long alloc_bytes;
+    atomic_long lookups;
+    long bytes_written;
+    bool counters;                  // --perf-counters was given
+    int hw_fd[HW_COUNT];            // -1 where the event could not be opened
+    uint64_t hw[PHASE_COUNT][HW_COUNT];
+} Profile;
+
+Profile prof = { 0 };
+
+typedef struct {
+    double wall, cpu;
+    uint64_t hw[HW_COUNT];
+} ProfMark;
+
+double prof_seconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Opens one counter per event for this process and the threads and
+// children it starts later; inherited counts are folded in as they exit.
+// Any event the kernel refuses (no PMU in a VM, perf_event_paranoid,
+// non-Linux) is reported as unavailable and the profile carries on.
+void hw_counters_open() {
+    for (int i = 0; i < HW_COUNT; i++) prof.hw_fd[i] = -1;
+#ifdef __linux__
+    static const uint64_t configs[HW_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    int opened = 0, err = 0;
+    for (int i = 0; i < HW_COUNT; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        prof.hw_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (prof.hw_fd[i] >= 0) opened++;
+        else err = errno;
+    }
+    if (opened == 0) {
+        fprintf(stderr, "Note: Hardware counters unavailable (%s); reporting timings only.\n", strerror(err));
+        prof.counters = false;
+    } else if (opened < HW_COUNT) {
+        fprintf(stderr, "Note: %d of %d hardware counters unavailable (%s).\n",
+                HW_COUNT - opened, HW_COUNT, strerror(err));
+    }
+#else
+    fprintf(stderr, "Note: Hardware counters need Linux perf_event_open; reporting timings only.\n");
+    prof.counters = false;
+#endif
+}
+
+// Current value of an event, scaled up if the kernel had to multiplex it
+uint64_t hw_read(int i) {
+    uint64_t v[3];
+    if (prof.hw_fd[i] < 0 || read(prof.hw_fd[i], v, sizeof(v)) != sizeof(v)) return 0;
+    if (v[2] > 0 && v[2] < v[1]) return (uint64_t)((double)v[0] * v[1] / v[2]);
+    return v[0];
+}
+
+ProfMark prof_mark() {
+    ProfMark m = { 0, 0, { 0 } };
+    if (!prof.enabled) return m;
+    if (prof.counters)
+        for (int i = 0; i < HW_COUNT; i++) m.hw[i] = hw_read(i);
+    struct rusage ru;
+    getrusage(RUSAGE_CHILDREN, &ru);
+    m.wall = prof_seconds(CLOCK_MONOTONIC);
+    m.cpu = prof_seconds(CLOCK_PROCESS_CPUTIME_ID) + ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+          + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+    return m;
+}
+
+void prof_end(Phase phase, ProfMark start) {
+    if (!prof.enabled) return;
+    ProfMark now = prof_mark();
+    prof.wall[phase] += now.wall - start.wall;
+    prof.cpu[phase] += now.cpu - start.cpu;
+    prof.calls[phase]++;
+    for (int i = 0; prof.counters && i < HW_COUNT; i++) prof.hw[phase][i] += now.hw[i] - start.hw[i];
+}
+
+void prof_count_alloc(size_t size) {
+    atomic_fetch_add_explicit(&prof.mallocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&prof.alloc_bytes, (long)size, memory_order_relaxed);
+}
+
+// Allocation helpers: every allocation in links goes through these, so
+// they feed the --profile counters and stop on failure
+void* xmalloc(size_t size) {
+    if (prof.enabled) prof_count_alloc(size);
+    void* p = malloc(size ? size : 1);
+    if (!p) { printf("Memory allocation failed\n"); exit(1); }
+    return p;
+}
+
+void* xcalloc(size_t n, size_t size) {
+    if (prof.enabled) prof_count_alloc(n * size);
+    void* p = calloc(n ? n : 1, size);
+    if (!p) { printf("Memory allocation failed\n"); exit(1); }
+    return p;
+}
+
+void* xrealloc(void* p, size_t size) {
+    if (prof.enabled) prof_count_alloc(size);
+    p = realloc(p, size ? size : 1);
+    if (!p) { printf("Memory allocation failed\n"); exit(1); }
+    return p;
+}
+
+// fclose() for output files that also tallies what was written
+int fclose_counted(FILE* f) {
+    if (prof.enabled) {
+        long pos = ftell(f);
+        if (pos > 0) prof.bytes_written += pos;
+    }
+    return fclose(f);
+}
+
+void prof_report() {
+    if (!prof.enabled) return;
+    long mallocs = atomic_load(&prof.mallocs);
+    long alloc_bytes = atomic_load(&prof.alloc_bytes);
+    long lookups = atomic_load(&prof.lookups);
+
+    if (prof.json_path) {
+        FILE* f = fopen(prof.json_path, "w");
+        if (!f) { fprintf(stderr, "Error: Could not write '%s'.\n", prof.json_path); return; }
+        fprintf(f, "{\n  \"phases\": {\n");
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            fprintf(f, "    \"%s\": {\"calls\": %d, \"wall_s\": %.6f, \"cpu_s\": %.6f", phase_names[i],
+                    prof.calls[i], prof.wall[i], prof.cpu[i]);
+            for (int k = 0; prof.counters && k < HW_COUNT; k++) {
+                if (prof.hw_fd[k] >= 0) fprintf(f, ", \"%s\": %llu", hw_names[k], (unsigned long long)prof.hw[i][k]);
+                else fprintf(f, ", \"%s\": null", hw_names[k]);
+            }
+            fprintf(f, "}%s\n", i + 1 < PHASE_COUNT ? "," : "");
+        }
+        fprintf(f, "  },\n  \"malloc_calls\": %ld,\n  \"bytes_allocated\": %ld,\n"
+                   "  \"lookups\": %ld,\n  \"bytes_written\": %ld\n}\n",
+                mallocs, alloc_bytes, lookups, prof.bytes_written);
+        fclose(f);
+        return;
+    }
+    fprintf(stderr, "\n--- Profile ---\n");
+    fprintf(stderr, "%-10s %12s %12s\n", "phase", "wall(ms)", "cpu(ms)");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        if (prof.calls[i] == 0) continue;
+        fprintf(stderr, "%-10s %12.3f %12.3f\n", phase_names[i], prof.wall[i] * 1e3, prof.cpu[i] * 1e3);
+    }
+    if (prof.calls[PHASE_GRAPHVIZ]) fprintf(stderr, "(graphviz time is included in command)\n");
+    if (prof.counters) {
+        fprintf(stderr, "\n%-10s %14s %14s %6s %12s %12s\n", "phase", "cycles", "instructions", "IPC",
+                "cache-miss", "branch-miss");
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            if (prof.calls[i] == 0) continue;
+            char col[HW_COUNT][24];
+            for (int k = 0; k < HW_COUNT; k++) {
+                if (prof.hw_fd[k] >= 0) snprintf(col[k], sizeof(col[k]), "%llu", (unsigned long long)prof.hw[i][k]);
+                else strcpy(col[k], "n/a");
+            }
+            char ipc[16] = "n/a";
+            if (prof.hw_fd[HW_CYCLES] >= 0 && prof.hw_fd[HW_INSTRUCTIONS] >= 0 && prof.hw[i][HW_CYCLES] > 0)
+                snprintf(ipc, sizeof(ipc), "%.2f", (double)prof.hw[i][HW_INSTRUCTIONS] / prof.hw[i][HW_CYCLES]);
+            fprintf(stderr, "%-10s %14s %14s %6s %12s %12s\n", phase_names[i], col[HW_CYCLES],
+                    col[HW_INSTRUCTIONS], ipc, col[HW_CACHE_MISSES], col[HW_BRANCH_MISSES]);
+        }
+        fprintf(stderr, "(user-space counts; Graphviz runs in a child and is part of command)\n\n");
+    }
+    fprintf(stderr, "malloc calls:    %ld\n", mallocs);
+    fprintf(stderr, "bytes allocated: %ld\n", alloc_bytes);
+    fprintf(stderr, "lookups:         %ld\n", lookups);
+    fprintf(stderr, "bytes written:   %ld\n", prof.bytes_written);
+}
+
+// --- Tracing ---
+
+// LINKS_TRACE=trace.json records nested spans in Chrome trace-event
+// format for chrome://tracing or Perfetto. Each thread appends to its
+// own ring buffer without locking; when a ring fills, the oldest spans
+// are overwritten. Span names must be string literals (or live until
+// exit), since only the pointer is stored.
+
+#define TRACE_RING_SIZE 16384   // Spans kept per thread
+#define TRACE_CHUNK_LINES 65536 // load_xml emits one span per this many lines
+
+typedef struct {
+    const char* name;
+    const char* cat;
+    double ts, dur;             // Microseconds since tracing started
+} TraceEvent;
+
+typedef struct TraceRing {
+    int tid;
+    long count;                 // Spans ever recorded; the ring keeps the last TRACE_RING_SIZE
+    TraceEvent ev[TRACE_RING_SIZE];
+    struct TraceRing* next;
+} TraceRing;
+
+typedef struct {
+    double start;
+    const char* name;
+    const char* cat;
+} TraceSpan;
+
+bool trace_on = false;
+double trace_t0 = 0;
+TraceRing* trace_rings = NULL;
+int trace_next_tid = 0;
+pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+_Thread_local TraceRing* trace_ring = NULL;
+
+double trace_now() {
+    return prof_seconds(CLOCK_MONOTONIC) * 1e6 - trace_t0;
+}
+
+void trace_init() {
+    const char* path = getenv("LINKS_TRACE");
+    if (!path || !path[0]) return;
+    trace_on = true;
+    trace_t0 = prof_seconds(CLOCK_MONOTONIC) * 1e6;
+}
+
+TraceSpan trace_begin(const char* name, const char* cat) {
+    TraceSpan s = { 0, name, cat };
+    if (trace_on) s.start = trace_now();
+    return s;
+}
+
+void trace_end(TraceSpan s) {
+    if (!trace_on) return;
+    double now = trace_now();
+    TraceRing* r = trace_ring;
+    if (!r) {
+        // First span on this thread: register a ring for it
+        r = (TraceRing*)xcalloc(1, sizeof(TraceRing));
+        pthread_mutex_lock(&trace_lock);
+        r->tid = trace_next_tid++;
+        r->next = trace_rings;
+        trace_rings = r;
+        pthread_mutex_unlock(&trace_lock);
+        trace_ring = r;
+    }
+    TraceEvent* e = &r->ev[r->count % TRACE_RING_SIZE];
+    e->name = s.name;
+    e->cat = s.cat;
+    e->ts = s.start;
+    e->dur = now - s.start;
+    r->count++;
+}
+
+void trace_json_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(f, "\\u%04x", (unsigned char)*s);
+        else fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// Writes every ring to $LINKS_TRACE. Call once worker threads have stopped.
+void trace_write() {
+    if (!trace_on) return;
+    const char* path = getenv("LINKS_TRACE");
+    FILE* f = fopen(path, "w");
+    if (!f) { fprintf(stderr, "Error: Could not write trace '%s'.\n", path); return; }
+
+    int pid = (int)getpid();
+    long dropped = 0;
+    bool first = true;
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (TraceRing* r = trace_rings; r; r = r->next) {
+        fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+                   "\"args\": {\"name\": \"%s %d\"}}",
+                first ? "" : ",\n", pid, r->tid, r->tid == 0 ? "main" : "worker", r->tid);
+        first = false;
+        long n = r->count < TRACE_RING_SIZE ? r->count : TRACE_RING_SIZE;
+        dropped += r->count - n;
+        for (long i = r->count - n; i < r->count; i++) {
+            TraceEvent* e = &r->ev[i % TRACE_RING_SIZE];
+            fprintf(f, ",\n{\"name\": ");
+            trace_json_string(f, e->name);
+            fprintf(f, ", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %d}",
+                    e->cat, e->ts, e->dur, pid, r->tid);
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    if (dropped > 0) fprintf(stderr, "Trace: %ld older spans were overwritten.\n", dropped);
+}
 
 // --- Helper Functions ---
 
+// Copies a name into a MAX_STR field, truncating and always terminating
+void copy_str(char* dst, const char* src) {
+    snprintf(dst, MAX_STR, "%.*s", MAX_STR - 1, src);
+}
+
 const char* dir_to_str(Direction d) {
     if (d == DIR_IN) return "in";
     if (d == DIR_OUT) return "out";
@@ -41,35 +407,73 @@ Direction str_to_dir(char* s) {
     return DIR_NONE;
 }
 
+uint64_t fnv1a64(const char* data, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void module_index_insert(Module* m) {
+    // Keep the load factor under 1/2
+    if ((size_t)(module_count + 1) * 2 > module_table_cap) {
+        TraceSpan span = trace_begin("module_index rehash", "index");
+        size_t new_cap = module_table_cap ? module_table_cap * 2 : 64;
+        Module** table = (Module**)xcalloc(new_cap, sizeof(Module*));
+        for (size_t i = 0; i < module_table_cap; i++) {
+            Module* old = module_table[i];
+            if (!old) continue;
+            size_t h = fnv1a64(old->name, strlen(old->name)) & (new_cap - 1);
+            while (table[h]) h = (h + 1) & (new_cap - 1);
+            table[h] = old;
+        }
+        free(module_table);
+        module_table = table;
+        module_table_cap = new_cap;
+        trace_end(span);
+    }
+    size_t h = fnv1a64(m->name, strlen(m->name)) & (module_table_cap - 1);
+    while (module_table[h]) h = (h + 1) & (module_table_cap - 1);
+    module_table[h] = m;
+}
+
 // Find or create a module
 Module* get_module(const char* name, bool create) {
     if (!name || strlen(name) == 0) return NULL; // Safety check
+    if (prof.enabled) atomic_fetch_add_explicit(&prof.lookups, 1, memory_order_relaxed);
 
-    Module* cur = root_modules;
-    Module* last = NULL;
-    while (cur) {
-        if (strcmp(cur->name, name) == 0) return cur;
-        last = cur;
-        cur = cur->next;
+    if (module_table_cap > 0) {
+        size_t h = fnv1a64(name, strlen(name)) & (module_table_cap - 1);
+        while (module_table[h]) {
+            if (strcmp(module_table[h]->name, name) == 0) return module_table[h];
+            h = (h + 1) & (module_table_cap - 1);
+        }
     }
     if (!create) return NULL;
 
-    Module* new_mod = (Module*)malloc(sizeof(Module));
-    if (!new_mod) { printf("Memory allocation failed\n"); exit(1); }
+    Module* new_mod = (Module*)xmalloc(sizeof(Module));
     
     strncpy(new_mod->name, name, MAX_STR - 1);
     new_mod->name[MAX_STR - 1] = '\0'; // Ensure null termination
+    new_mod->group[0] = '\0';
     new_mod->ports = NULL;
+    new_mod->idx = module_count;
     new_mod->next = NULL;
 
-    if (last) last->next = new_mod;
+    if (last_module) last_module->next = new_mod;
     else root_modules = new_mod;
+    last_module = new_mod;
+    module_index_insert(new_mod);
+    module_count++;
     return new_mod;
 }
 
 // Find or create a port
 Port* get_port(Module* mod, const char* port_name, bool create) {
     if (!mod || !port_name || strlen(port_name) == 0) return NULL;
+    if (prof.enabled) atomic_fetch_add_explicit(&prof.lookups, 1, memory_order_relaxed);
 
     Port* cur = mod->ports;
     Port* last = NULL;
@@ -80,17 +484,13 @@ Port* get_port(Module* mod, const char* port_name, bool create) {
     }
     if (!create) return NULL;
 
-    Port* new_port = (Port*)malloc(sizeof(Port));
-    if (!new_port) { printf("Memory allocation failed\n"); exit(1); }
+    Port* new_port = (Port*)xmalloc(sizeof(Port));
+    // Zero every field so a later strncpy(..., MAX_STR - 1) stays terminated
+    memset(new_port, 0, sizeof(Port));
 
     strncpy(new_port->name, port_name, MAX_STR - 1);
     new_port->name[MAX_STR - 1] = '\0';
-    
-    strcpy(new_port->type, ""); // Default to empty
-    strcpy(new_port->dest_module, "");
-    strcpy(new_port->dest_port, "");
     new_port->dir = DIR_NONE;
-    new_port->next = NULL;
 
     if (last) last->next = new_port;
     else mod->ports = new_port;
@@ -99,13 +499,17 @@ Port* get_port(Module* mod, const char* port_name, bool create) {
 
 // --- XML Persistence ---
 
+// Writes the model to a temporary file and renames it over FILE_NAME, so
+// readers and a crash mid-write only ever see the old or the new model
 void save_xml() {
-    FILE* f = fopen(FILE_NAME, "w");
+    FILE* f = fopen(FILE_NAME ".tmp", "w");
     if (!f) return;
+    TraceSpan span = trace_begin("save_xml", "io");
     fprintf(f, "<root>\n");
     Module* m = root_modules;
     while (m) {
-        fprintf(f, "  <module name=\"%s\">\n", m->name);
+        if (m->group[0]) fprintf(f, "  <module name=\"%s\" group=\"%s\">\n", m->name, m->group);
+        else fprintf(f, "  <module name=\"%s\">\n", m->name);
         Port* p = m->ports;
         while (p) {
             fprintf(f, "    <port name=\"%s\" type=\"%s\" dir=\"%s\" dest_mod=\"%s\" dest_port=\"%s\" />\n",
@@ -116,42 +520,100 @@ void save_xml() {
         m = m->next;
     }
     fprintf(f, "</root>\n");
-    fclose(f);
+    bool failed = ferror(f);
+    if (fclose_counted(f) != 0 || failed || rename(FILE_NAME ".tmp", FILE_NAME) != 0) {
+        printf("Error: Could not write %s; it was left unchanged.\n", FILE_NAME);
+        remove(FILE_NAME ".tmp");
+    }
+    trace_end(span);
 }
 
-void load_xml() {
-    FILE* f = fopen(FILE_NAME, "r");
-    if (!f) return;
+// Parses a links_data.xml stream into the model. Malformed lines are
+// skipped rather than trusted: this is the fuzzing entry point.
+void load_xml_stream(FILE* f) {
+    TraceSpan span = trace_begin("load_xml", "io");
+    TraceSpan chunk = trace_begin("parse chunk", "parse");
+    long lines = 0;
     
     char line[512];
     Module* current_mod = NULL;
 
     while (fgets(line, sizeof(line), f)) {
+        if (trace_on && ++lines % TRACE_CHUNK_LINES == 0) {
+            trace_end(chunk);
+            chunk = trace_begin("parse chunk", "parse");
+        }
         if (strstr(line, "<module")) {
-            char* name_start = strstr(line, "name=\"") + 6;
-            char* name_end = strchr(name_start, '\"');
+            char* name_start = strstr(line, "name=\"");
+            char* name_end = name_start ? strchr(name_start + 6, '\"') : NULL;
+            current_mod = NULL;
             if (name_end) {
+                name_start += 6;
                 *name_end = '\0';
                 current_mod = get_module(name_start, true);
+
+                char* group_start = strstr(name_end + 1, "group=\"");
+                if (group_start && current_mod) {
+                    group_start += 7;
+                    char* group_end = strchr(group_start, '\"');
+                    if (group_end) {
+                        size_t len = group_end - group_start;
+                        if (len >= MAX_STR) len = MAX_STR - 1;
+                        memcpy(current_mod->group, group_start, len);
+                        current_mod->group[len] = '\0';
+                    }
+                }
             }
         } else if (strstr(line, "<port") && current_mod) {
             char name[MAX_STR], type[MAX_STR], dir_s[MAX_STR], dmod[MAX_STR], dport[MAX_STR];
             // Clear buffers first
             name[0] = 0; type[0] = 0; dir_s[0] = 0; dmod[0] = 0; dport[0] = 0;
 
-            sscanf(line, "    <port name=\"%[^\"]\" type=\"%[^\"]\" dir=\"%[^\"]\" dest_mod=\"%[^\"]\" dest_port=\"%[^\"]\"", 
+            // Field widths are MAX_STR - 1
+            sscanf(line, "    <port name=\"%63[^\"]\" type=\"%63[^\"]\" dir=\"%63[^\"]\" dest_mod=\"%63[^\"]\" dest_port=\"%63[^\"]\"", 
                    name, type, dir_s, dmod, dport);
             
             Port* p = get_port(current_mod, name, true);
-            strncpy(p->type, type, MAX_STR - 1);
+            if (!p) continue; // No port name
+            copy_str(p->type, type);
             p->dir = str_to_dir(dir_s);
-            strncpy(p->dest_module, dmod, MAX_STR - 1);
-            strncpy(p->dest_port, dport, MAX_STR - 1);
+            copy_str(p->dest_module, dmod);
+            copy_str(p->dest_port, dport);
         }
     }
+    trace_end(chunk);
+    trace_end(span);
+}
+
+void load_xml() {
+    FILE* f = fopen(FILE_NAME, "r");
+    if (!f) return;
+    load_xml_stream(f);
     fclose(f);
 }
 
+// Drops the whole model. The CLI exits instead; the benchmarks and fuzz
+// targets reload many times in one process.
+void model_free() {
+    Module* m = root_modules;
+    while (m) {
+        Port* p = m->ports;
+        while (p) {
+            Port* next = p->next;
+            free(p);
+            p = next;
+        }
+        Module* next = m->next;
+        free(m);
+        m = next;
+    }
+    root_modules = last_module = NULL;
+    module_count = 0;
+    free(module_table);
+    module_table = NULL;
+    module_table_cap = 0;
+}
+
 // --- Robust Parsing ---
 
 // Parses "mod::port:type", "mod::port", or just "mod"
@@ -201,6 +663,381 @@ bool parse_arg_safe(char* input, char* m_out, char* p_out, char* t_out) {
     return (strlen(m_out) > 0);
 }
 
+// --- Thread Pool ---
+
+// Work-stealing pool shared by the analysis commands. Each worker owns a
+// deque: it pops its own tasks from the bottom and steals from the top of
+// the others when it runs dry. The calling thread acts as worker 0, so a
+// pool of one thread runs everything inline.
+
+typedef void (*TaskFn)(void* ctx, int begin, int end);
+
+typedef struct {
+    TaskFn fn;
+    void* ctx;
+    int begin, end;
+} Task;
+
+typedef struct {
+    Task* tasks;
+    int head, tail, cap;
+    pthread_mutex_t lock;
+} TaskDeque;
+
+typedef struct {
+    int n_workers;
+    pthread_t* threads;
+    TaskDeque* deques;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;
+    pthread_cond_t done_cv;
+    atomic_int queued;   // tasks sitting in deques
+    atomic_int pending;  // tasks not yet finished
+    bool shutdown;
+} ThreadPool;
+
+int opt_threads = 0; // 0 = one per core
+ThreadPool* pool = NULL;
+
+int pool_thread_count() {
+    if (opt_threads > 0) return opt_threads;
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > MAX_THREADS) n = MAX_THREADS;
+    return (int)n;
+}
+
+void deque_push(TaskDeque* d, Task t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->tail == d->cap) {
+        // Compact before growing; stolen slots at the front are free again
+        if (d->head > 0) {
+            memmove(d->tasks, d->tasks + d->head, (d->tail - d->head) * sizeof(Task));
+            d->tail -= d->head;
+            d->head = 0;
+        }
+        if (d->tail == d->cap) {
+            d->cap = d->cap ? d->cap * 2 : 64;
+            d->tasks = (Task*)xrealloc(d->tasks, d->cap * sizeof(Task));
+        }
+    }
+    d->tasks[d->tail++] = t;
+    pthread_mutex_unlock(&d->lock);
+}
+
+// Owner end: LIFO keeps recently split chunks hot in cache
+bool deque_pop(TaskDeque* d, Task* out) {
+    bool ok = false;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) { *out = d->tasks[--d->tail]; ok = true; }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+// Thief end: FIFO takes the oldest (largest remaining) work
+bool deque_steal(TaskDeque* d, Task* out) {
+    bool ok = false;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) { *out = d->tasks[d->head++]; ok = true; }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+bool pool_take(int self, Task* out) {
+    bool ok = deque_pop(&pool->deques[self], out);
+    for (int i = 1; !ok && i < pool->n_workers; i++) {
+        int victim = (self + i) % pool->n_workers;
+        ok = deque_steal(&pool->deques[victim], out);
+    }
+    if (ok) atomic_fetch_sub(&pool->queued, 1);
+    return ok;
+}
+
+void pool_run_task(Task* t) {
+    TraceSpan span = trace_begin("pool task", "pool");
+    t->fn(t->ctx, t->begin, t->end);
+    trace_end(span);
+    if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->done_cv);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+void* pool_worker(void* arg) {
+    int self = (int)(long)arg;
+    Task t;
+    for (;;) {
+        if (pool_take(self, &t)) { pool_run_task(&t); continue; }
+
+        pthread_mutex_lock(&pool->lock);
+        while (atomic_load(&pool->queued) == 0 && !pool->shutdown)
+            pthread_cond_wait(&pool->work_cv, &pool->lock);
+        bool stop = pool->shutdown;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop) return NULL;
+    }
+}
+
+void pool_init() {
+    if (pool) return;
+    pool = (ThreadPool*)xcalloc(1, sizeof(ThreadPool));
+
+    pool->n_workers = pool_thread_count();
+    pool->deques = (TaskDeque*)xcalloc(pool->n_workers, sizeof(TaskDeque));
+    pool->threads = (pthread_t*)xcalloc(pool->n_workers, sizeof(pthread_t));
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cv, NULL);
+    pthread_cond_init(&pool->done_cv, NULL);
+    for (int i = 0; i < pool->n_workers; i++) pthread_mutex_init(&pool->deques[i].lock, NULL);
+
+    // Worker 0 is the calling thread
+    for (int i = 1; i < pool->n_workers; i++) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, (void*)(long)i) != 0) {
+            pool->n_workers = i; // Run with whatever we managed to start
+            break;
+        }
+    }
+}
+
+void pool_shutdown() {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->n_workers; i++) pthread_join(pool->threads[i], NULL);
+    for (int i = 0; i < pool->n_workers; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cv);
+    pthread_cond_destroy(&pool->done_cv);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool);
+    pool = NULL;
+}
+
+// Runs fn over [0, n) in chunks of 'chunk' items and waits for completion.
+// Chunks are dealt round-robin; idle workers steal the rest.
+void pool_parallel_for(int n, int chunk, TaskFn fn, void* ctx) {
+    if (n <= 0) return;
+    if (chunk < 1) chunk = 1;
+    if (pool_thread_count() == 1 || n <= chunk) { fn(ctx, 0, n); return; }
+
+    pool_init();
+    int n_tasks = (n + chunk - 1) / chunk;
+    atomic_fetch_add(&pool->pending, n_tasks);
+    atomic_fetch_add(&pool->queued, n_tasks);
+    for (int i = 0; i < n_tasks; i++) {
+        Task t = { fn, ctx, i * chunk, (i + 1) * chunk < n ? (i + 1) * chunk : n };
+        deque_push(&pool->deques[i % pool->n_workers], t);
+    }
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    // Help out until our deque and everyone else's are empty
+    Task t;
+    while (pool_take(0, &t)) pool_run_task(&t);
+
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&pool->pending) > 0)
+        pthread_cond_wait(&pool->done_cv, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Snapshot of the module list as an array, so work can be split by index
+Module** module_array(int* count) {
+    int n = 0;
+    for (Module* m = root_modules; m; m = m->next) n++;
+    Module** arr = (Module**)xmalloc((n ? n : 1) * sizeof(Module*));
+    n = 0;
+    for (Module* m = root_modules; m; m = m->next) arr[n++] = m;
+    *count = n;
+    return arr;
+}
+
+// --- Graph Index ---
+
+// Module-level adjacency in CSR form, built from the port lists. Each
+// linked port contributes one edge, so parallel links stay parallel.
+// Links to modules that do not exist (or are filtered out) are left out.
+
+typedef struct {
+    int n;                  // Nodes; node i is module mods[i]
+    Module** mods;
+    int* node_of;           // Module::idx -> node, or -1 if not in the graph
+    int n_edges;
+    int* succ_off;          // succ[succ_off[i] .. succ_off[i+1]) = targets of i
+    int* succ;
+    int* pred_off;          // pred[pred_off[i] .. pred_off[i+1]) = sources of i
+    int* pred;
+} Graph;
+
+// Builds the graph over all modules, or only those with keep[idx] set
+Graph* graph_build(const bool* keep) {
+    TraceSpan span = trace_begin("graph_build", "index");
+    Graph* g = (Graph*)xcalloc(1, sizeof(Graph));
+    g->mods = (Module**)xcalloc(module_count, sizeof(Module*));
+    g->node_of = (int*)xcalloc(module_count, sizeof(int));
+    for (Module* m = root_modules; m; m = m->next) {
+        g->node_of[m->idx] = -1;
+        if (keep && !keep[m->idx]) continue;
+        g->node_of[m->idx] = g->n;
+        g->mods[g->n++] = m;
+    }
+
+    // Resolve every link once, then count, prefix-sum and fill
+    int* dst = NULL;
+    int cap = 0;
+    g->succ_off = (int*)xcalloc(g->n + 1, sizeof(int));
+    g->pred_off = (int*)xcalloc(g->n + 1, sizeof(int));
+    for (int i = 0; i < g->n; i++) {
+        for (Port* p = g->mods[i]->ports; p; p = p->next) {
+            if (p->dir != DIR_OUT || p->dest_module[0] == '\0') continue;
+            Module* dm = get_module(p->dest_module, false);
+            if (!dm || g->node_of[dm->idx] < 0) continue;
+            int v = g->node_of[dm->idx];
+            if (g->n_edges == cap) {
+                cap = cap ? cap * 2 : 256;
+                dst = (int*)xrealloc(dst, cap * 2 * sizeof(int));
+            }
+            dst[2 * g->n_edges] = i;
+            dst[2 * g->n_edges + 1] = v;
+            g->n_edges++;
+            g->succ_off[i + 1]++;
+            g->pred_off[v + 1]++;
+        }
+    }
+    for (int i = 0; i < g->n; i++) {
+        g->succ_off[i + 1] += g->succ_off[i];
+        g->pred_off[i + 1] += g->pred_off[i];
+    }
+
+    g->succ = (int*)xcalloc(g->n_edges, sizeof(int));
+    g->pred = (int*)xcalloc(g->n_edges, sizeof(int));
+    int* s_fill = (int*)xcalloc(g->n, sizeof(int));
+    int* p_fill = (int*)xcalloc(g->n, sizeof(int));
+    for (int e = 0; e < g->n_edges; e++) {
+        int u = dst[2 * e], v = dst[2 * e + 1];
+        g->succ[g->succ_off[u] + s_fill[u]++] = v;
+        g->pred[g->pred_off[v] + p_fill[v]++] = u;
+    }
+    free(s_fill);
+    free(p_fill);
+    free(dst);
+    trace_end(span);
+    return g;
+}
+
+// Marks the nodes within 'depth' links of 'start', breadth-first,
+// following links downstream, upstream or both
+bool* graph_neighbourhood(Graph* g, int start, int depth, bool up, bool down) {
+    bool* seen = (bool*)xcalloc(g->n, sizeof(bool));
+    int* queue = (int*)xcalloc(g->n, sizeof(int));
+    int* dist = (int*)xcalloc(g->n, sizeof(int));
+    int head = 0, tail = 0;
+    seen[start] = true;
+    queue[tail++] = start;
+    while (head < tail) {
+        int u = queue[head++];
+        if (dist[u] >= depth) continue;
+        for (int pass = 0; pass < 2; pass++) {
+            if ((pass == 0 && !down) || (pass == 1 && !up)) continue;
+            int* off = pass == 0 ? g->succ_off : g->pred_off;
+            int* adj = pass == 0 ? g->succ : g->pred;
+            for (int e = off[u]; e < off[u + 1]; e++) {
+                int v = adj[e];
+                if (seen[v]) continue;
+                seen[v] = true;
+                dist[v] = dist[u] + 1;
+                queue[tail++] = v;
+            }
+        }
+    }
+    free(queue);
+    free(dist);
+    return seen;
+}
+
+void graph_free(Graph* g) {
+    if (!g) return;
+    free(g->mods);
+    free(g->node_of);
+    free(g->succ_off);
+    free(g->succ);
+    free(g->pred_off);
+    free(g->pred);
+    free(g);
+}
+
+// --- Validation ---
+
+typedef struct {
+    Module** mods;
+    char** reports;     // Per-module findings, NULL when the module is clean
+    atomic_int issues;
+} CheckCtx;
+
+void check_range(void* arg, int begin, int end) {
+    CheckCtx* ctx = (CheckCtx*)arg;
+    for (int i = begin; i < end; i++) {
+        Module* m = ctx->mods[i];
+        char* buf = NULL;
+        size_t len = 0;
+        FILE* out = NULL;
+        int found = 0;
+
+        for (Port* p = m->ports; p; p = p->next) {
+            if (p->dir != DIR_OUT || p->dest_module[0] == '\0') continue;
+
+            char problem[256];
+            problem[0] = '\0';
+            Module* dm = get_module(p->dest_module, false);
+            Port* dp = dm ? get_port(dm, p->dest_port, false) : NULL;
+            if (!dm)
+                snprintf(problem, sizeof(problem), "destination module '%s' does not exist", p->dest_module);
+            else if (!dp)
+                snprintf(problem, sizeof(problem), "destination port '%s::%s' does not exist", p->dest_module, p->dest_port);
+            else if (dp->dir != DIR_IN)
+                snprintf(problem, sizeof(problem), "destination '%s::%s' is not an input (dir=%s)",
+                         p->dest_module, p->dest_port, dir_to_str(dp->dir));
+            else if (strcmp(p->type, dp->type) != 0)
+                snprintf(problem, sizeof(problem), "type mismatch: %s -> %s", p->type, dp->type);
+            if (problem[0] == '\0') continue;
+
+            if (!out) out = open_memstream(&buf, &len);
+            if (!out) { printf("Memory allocation failed\n"); exit(1); }
+            fprintf(out, "  %s::%s: %s\n", m->name, p->name, problem);
+            found++;
+        }
+        if (out) fclose(out);
+        ctx->reports[i] = buf;
+        if (found) atomic_fetch_add(&ctx->issues, found);
+    }
+}
+
+// --- Change Events ---
+
+// With --events, every port a command creates or changes is reported on
+// stdout as one tab-separated line, so a front end can patch just those
+// rows instead of re-reading the whole model:
+//   event  added|edited  module  port  type  dir  dest_mod  dest_port
+// Links are never deleted outright: removing one edits its source port.
+
+bool opt_events = false;
+
+void emit_port_event(const char* kind, Module* m, Port* p) {
+    if (!opt_events) return;
+    printf("event\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n", kind, m->name, p->name, p->type,
+           dir_to_str(p->dir), p->dest_module, p->dest_port);
+}
+
 // --- Commands ---
 
 void print_usage() {
@@ -217,6 +1054,15 @@ void print_usage() {
     printf("  remove  <src> <dst>   Remove an existing link.\n");
     printf("                        Example: links remove Sensor::Out Processor::In\n\n");
     
+    printf("  relink  <src> <old_dst> <new_dst>\n");
+    printf("                        Point an existing link at a new destination in one step.\n");
+    printf("                        Example: links relink Sensor::Out Processor::In Logger::In\n\n");
+
+    printf("  set     <mod::port> field=value... [<mod::port> field=value...]\n");
+    printf("                        Set type, dir (in|out|none) or dest (mod::port, empty to unlink)\n");
+    printf("                        on one or more ports at once; nothing changes if any argument is bad.\n");
+    printf("                        Example: links set Sensor::Out type=int dest=Logger::In\n\n");
+
     printf("  edit    <mod::port> <type> <dir> Edit a port's type and direction (in|out|none).\n");
     printf("                        Example: links edit Sensor::Out int out\n\n"); // <-- NEW
 
@@ -230,12 +1076,88 @@ void print_usage() {
 
     printf("  draw                  Print a text-based hierarchy diagram to the console.\n\n");
 
-    printf("  dot                   Generate 'graph.dot' and 'graph.svg' (requires Graphviz).\n\n");
+    printf("  dot     [--formats svg,png] [--no-cache] [--engine dot|native]\n");
+    printf("                        Generate 'graph.dot' and render it once into each format (requires Graphviz).\n");
+    printf("                        Unchanged graphs are served from '.links-cache/'.\n");
+    printf("                        --engine native lays out large graphs in-process (SVG only),\n");
+    printf("                        reusing positions from 'graph.layout' unless --fresh is given.\n");
+    printf("          [--focus <module> [--depth N] [--up|--down]]\n");
+    printf("                        Only render modules within N links of <module> (default 1),\n");
+    printf("                        following links upstream, downstream or both.\n");
+    printf("          [--cluster prefix|component|group] [--collapse]\n");
+    printf("                        Draw modules inside clusters by name prefix, connected component\n");
+    printf("                        or 'group'; --collapse draws each cluster as one summary node.\n");
+    printf("          [--aggregate]\n");
+    printf("                        Merge all links between two modules into one edge labelled\n");
+    printf("                        with the signal count and types.\n");
+    printf("                        Example: links dot --formats svg\n\n");
+
+    printf("  group   <module> [name] Put a module in a named group (omit the name to clear it).\n");
+    printf("                        Example: links group Lidar Perception\n\n");
+
+    printf("  check                 Validate every link (missing endpoints, direction, type mismatches).\n\n");
+
+    printf("  dsm     [--order topo|cluster|list] [--format text|csv|svg] [-o file]\n");
+    printf("                        Print the module dependency matrix (row reads from column).\n");
+    printf("                        topo moves as many links as possible below the diagonal;\n");
+    printf("                        cluster keeps each cluster together ([--cluster prefix|component|group]).\n");
+    printf("                        svg writes a heatmap to 'dsm.svg' unless -o is given.\n");
+    printf("                        Example: links dsm --order topo --format svg\n\n");
 
-    printf("  help                  Show this help message.\n");
+    printf("  export  --html [-o file] [--fresh]\n");
+    printf("                        Write a self-contained zoomable viewer ('graph.html') from the\n");
+    printf("                        native layout. Links and ports load tile by tile as you zoom in.\n\n");
+
+    printf("  rows    [--sort <column>] [--desc] [--filter text] [--offset N] [--limit N] [--find <mod::port>]\n");
+    printf("                        Print one window of the link table, filtered and sorted, as\n");
+    printf("                        tab-separated rows (used by the GUI's virtual list). Columns:\n");
+    printf("                        src_mod, src_port, src_type, dst_mod, dst_port, dst_type.\n");
+    printf("                        --find centres the window on the link from <mod::port>.\n\n");
+
+    printf("  mem                   Report heap bytes by category (module and port nodes, strings,\n");
+    printf("                        indexes, edge arrays), bytes per port and peak RSS.\n\n");
+
+    printf("  gen     [--modules N] [--ports-per M] [--edges E] [--seed S] [-o file] [--force]\n");
+    printf("                        Write a synthetic layered model for benchmarking (default: 1000\n");
+    printf("                        modules, 8 ports each, N*M/3 links, seed 1, '%s').\n\n", FILE_NAME);
+
+    printf("  help                  Show this help message.\n\n");
+
+    printf("OPTIONS:\n");
+    printf("  --threads N           Worker threads for analysis commands (default: one per core).\n");
+    printf("  --profile[=file.json] Report wall and CPU time for load, command, save and Graphviz,\n");
+    printf("                        plus malloc calls, bytes allocated, lookups and bytes written.\n");
+    printf("                        The report goes to stderr, or to the JSON file if one is given.\n");
+    printf("  --perf-counters       Add cycles, instructions, cache misses and branch misses per phase\n");
+    printf("                        to the profile (Linux perf_event_open; skipped if unavailable).\n");
+    printf("  --events              After a change, print one tab-separated line per port it added\n");
+    printf("                        or edited: event, added|edited, module, port, type, dir,\n");
+    printf("                        dest_mod, dest_port (used by the GUI to patch its view).\n");
+    printf("\nENVIRONMENT:\n");
+    printf("  LINKS_TRACE=file.json Record load, index, command, output and Graphviz spans in\n");
+    printf("                        Chrome trace format (open in Perfetto or chrome://tracing).\n");
     printf("\n");
 }
 
+// Points ps at d_mod::d_port, creating the destination if needed and
+// making it an input of d_type (the source's type when empty)
+void link_port(Port* ps, const char* d_mod, const char* d_port, const char* d_type) {
+    Module* md = get_module(d_mod, true);
+    bool d_new = get_port(md, d_port, false) == NULL;
+    Port* pd = get_port(md, d_port, true);
+    copy_str(pd->type, d_type[0] ? d_type : ps->type);
+
+    ps->dir = DIR_OUT;
+    copy_str(ps->dest_module, d_mod);
+    copy_str(ps->dest_port, d_port);
+
+    pd->dir = DIR_IN;
+    // Clear dest info on IN port just in case
+    pd->dest_module[0] = '\0';
+    pd->dest_port[0] = '\0';
+    emit_port_event(d_new ? "added" : "edited", md, pd);
+}
+
 void cmd_add(int argc, char* argv[]) {
     if (argc != 4) {
         printf("Error: 'add' requires source and destination.\nUsage: links add src_arg dst_arg\n");
@@ -272,25 +1194,16 @@ void cmd_add(int argc, char* argv[]) {
 
     // 4. Create/Link Objects
     Module* ms = get_module(s_mod, true);
+    bool s_new = get_port(ms, s_port, false) == NULL;
     Port* ps = get_port(ms, s_port, true);
-    strncpy(ps->type, s_type, MAX_STR-1);
-
-    Module* md = get_module(d_mod, true);
-    Port* pd = get_port(md, d_port, true);
-    strncpy(pd->type, d_type, MAX_STR-1);
+    copy_str(ps->type, s_type);
 
     // 5. Link
-    ps->dir = DIR_OUT;
-    strncpy(ps->dest_module, d_mod, MAX_STR-1);
-    strncpy(ps->dest_port, d_port, MAX_STR-1);
-
-    pd->dir = DIR_IN;
-    // Clear dest info on IN port just in case
-    pd->dest_module[0] = '\0';
-    pd->dest_port[0] = '\0';
+    link_port(ps, d_mod, d_port, d_type);
 
     printf("Linked: [%s::%s:%s] -> [%s::%s:%s]\n", 
            s_mod, s_port, s_type, d_mod, d_port, d_type);
+    emit_port_event(s_new ? "added" : "edited", ms, ps);
 }
 
 void cmd_remove(int argc, char* argv[]) {
@@ -314,6 +1227,7 @@ void cmd_remove(int argc, char* argv[]) {
         p->dest_port[0] = '\0';
         p->dir = DIR_NONE;
         printf("Link removed.\n");
+        emit_port_event("edited", m, p);
     } else {
         printf("Link not found.\n");
     }
@@ -377,7 +1291,119 @@ void cmd_edit(int argc, char* argv[]) {
     
     printf("Edited port [%s::%s]. New Type: %s, New Dir: %s\n", 
            m_name, p_name, p->type, dir_to_str(p->dir));
-    printf("Note: To change destination for an 'out' port, use 'add' to relink.\n");
+    printf("Note: To change destination for an 'out' port, use 'relink'.\n");
+    emit_port_event("edited", m, p);
+}
+
+// Moves one end of an existing link in a single load and save, where
+// 'remove' then 'add' would write the model twice and briefly drop the link
+void cmd_relink(int argc, char* argv[]) {
+    if (argc != 5) {
+        printf("Usage: links relink src_mod::src_port old_dst_mod::old_dst_port new_dst_mod::new_dst_port[:Type]\n");
+        return;
+    }
+    char s_mod[MAX_STR], s_port[MAX_STR], tmp[MAX_STR];
+    char o_mod[MAX_STR], o_port[MAX_STR];
+    char n_mod[MAX_STR], n_port[MAX_STR], n_type[MAX_STR];
+
+    if (!parse_arg_safe(argv[2], s_mod, s_port, tmp) || !parse_arg_safe(argv[3], o_mod, o_port, tmp) ||
+        !parse_arg_safe(argv[4], n_mod, n_port, n_type)) {
+        printf("Error: Invalid argument format for Module::Port.\n"); return;
+    }
+    if (strlen(s_port) == 0 || strlen(n_port) == 0) {
+        printf("Error: Must specify a port (e.g., Module::Port).\n"); return;
+    }
+
+    Module* m = get_module(s_mod, false);
+    Port* p = m ? get_port(m, s_port, false) : NULL;
+    if (!p || strcmp(p->dest_module, o_mod) != 0 || strcmp(p->dest_port, o_port) != 0) {
+        printf("Link not found.\n");
+        return;
+    }
+
+    link_port(p, n_mod, n_port, n_type);
+    printf("Relinked: [%s::%s] -> [%s::%s] (was [%s::%s])\n", s_mod, s_port, n_mod, n_port, o_mod, o_port);
+    emit_port_event("edited", m, p);
+}
+
+// Sets fields on one or more ports in a single load and save:
+//   links set Mod::Port[:Type] field=value... [Mod::Port[:Type] field=value...]
+// Fields are type, dir (in|out|none) and dest (Mod::Port[:Type], empty to
+// unlink, which leaves the port 'none' as 'remove' does). Missing ports are
+// created, as with 'add'. Every argument is checked before anything
+// changes, so a bad one (or a port with no fields) leaves the model as it was.
+void cmd_set(int argc, char* argv[]) {
+    if (argc < 4) {
+        printf("Error: 'set' requires a port and at least one field.\n"
+               "Usage: links set Module::Port field=value... (fields: type, dir, dest)\n");
+        return;
+    }
+
+    int updated = 0;
+    for (int apply = 0; apply < 2; apply++) {
+        Module* m = NULL;
+        Port* p = NULL;
+        bool p_new = false;
+        bool have_port = false;
+        const char* bare = NULL; // Port token still waiting for a field
+        for (int i = 2; i < argc; i++) {
+            char mod[MAX_STR], port[MAX_STR], type[MAX_STR];
+            char* eq = strchr(argv[i], '=');
+            if (!eq) {
+                // A port: the fields that follow apply to it
+                if (!parse_arg_safe(argv[i], mod, port, type) || strlen(port) == 0) {
+                    printf("Error: Expected Module::Port or field=value, got '%s'.\n", argv[i]); return;
+                }
+                if (bare) { printf("Error: No fields given for '%s'.\n", bare); return; }
+                have_port = true;
+                bare = argv[i];
+                if (!apply) continue;
+                if (p) emit_port_event(p_new ? "added" : "edited", m, p);
+                m = get_module(mod, true);
+                p_new = get_port(m, port, false) == NULL;
+                p = get_port(m, port, true);
+                if (type[0]) copy_str(p->type, type);
+                updated++;
+                continue;
+            }
+            if (!have_port) { printf("Error: '%s' must follow a Module::Port.\n", argv[i]); return; }
+            bare = NULL;
+
+            size_t key_len = eq - argv[i];
+            char* value = eq + 1;
+            if (key_len == 4 && strncmp(argv[i], "type", 4) == 0) {
+                if (!value[0]) { printf("Error: type must not be empty.\n"); return; }
+                if (apply) copy_str(p->type, value);
+            } else if (key_len == 3 && strncmp(argv[i], "dir", 3) == 0) {
+                if (strcmp(value, "in") != 0 && strcmp(value, "out") != 0 && strcmp(value, "none") != 0) {
+                    printf("Error: dir must be in, out or none, got '%s'.\n", value); return;
+                }
+                if (!apply) continue;
+                p->dir = str_to_dir(value);
+                if (p->dir != DIR_OUT) {
+                    p->dest_module[0] = '\0';
+                    p->dest_port[0] = '\0';
+                }
+            } else if (key_len == 4 && strncmp(argv[i], "dest", 4) == 0) {
+                if (value[0] && (!parse_arg_safe(value, mod, port, type) || strlen(port) == 0)) {
+                    printf("Error: dest must be Module::Port, got '%s'.\n", value); return;
+                }
+                if (!apply) continue;
+                if (value[0]) {
+                    link_port(p, mod, port, type);
+                } else {
+                    p->dest_module[0] = '\0';
+                    p->dest_port[0] = '\0';
+                    p->dir = DIR_NONE;
+                }
+            } else {
+                printf("Error: Unknown field '%.*s' (expected type, dir or dest).\n", (int)key_len, argv[i]); return;
+            }
+        }
+        if (bare) { printf("Error: No fields given for '%s'.\n", bare); return; }
+        if (apply && p) emit_port_event(p_new ? "added" : "edited", m, p);
+    }
+    printf("Updated %d port%s.\n", updated, updated == 1 ? "" : "s");
 }
 
 
@@ -507,16 +1533,1573 @@ void cmd_draw() {
     }
 }
 
-void cmd_dot() {
-    FILE* f = fopen("graph.dot", "w");
-    if (!f) return;
+// --- Native Layout ---
 
-    fprintf(f, "digraph G {\n");
-    fprintf(f, "  rankdir=LR;\n");
-    
-    // Use polyline to prevent wires from 'floating' or missing ports
-    fprintf(f, "  splines=polyline;\n");
-    
+// Sugiyama-style layered layout for graphs too large for Graphviz: break
+// cycles, assign layers by longest path, route long edges through dummy
+// nodes, reduce crossings with barycentric sweeps, then assign coordinates.
+// Layers run left to right, matching rankdir=LR in the DOT output.
+
+#define ROW_H 20.0
+#define CHAR_W 7.0
+#define NAME_H 32.0
+#define NODE_SEP 24.0
+#define RANK_SEP 80.0
+#define MARGIN 20.0
+#define LAYOUT_SWEEPS 8
+#define COORD_PASSES 4
+#define MAX_DUMMY_SPAN 8
+
+typedef struct { int from, to; } Pair;
+
+typedef struct {
+    int n_mods;             // Nodes [0, n_mods) are modules, the rest are dummies
+    int n_nodes;
+    int* layer;
+    int* pos;               // Index within its layer
+    double *x, *y, *w, *h;  // Box top-left corner and size
+    int n_layers;
+    int* layer_off;         // layer_nodes[layer_off[l] .. layer_off[l+1]) in order
+    int* layer_nodes;
+    int *up_off, *up;       // Neighbours in the previous layer
+    int *down_off, *down;   // Neighbours in the next layer
+    int n_pairs;            // Distinct linked module pairs, sorted
+    Pair* pairs;
+    bool* reversed;         // Pair was flipped to break a cycle
+    int* chain_off;         // Node path of each pair, in layout direction
+    int* chain;
+    double width, height;
+    double* fixed_y;        // Warm start: previous top of each node, or -1
+                            // for nodes that have to be placed afresh
+} Layout;
+
+// Placement of each module in the previous render, read back from
+// LAYOUT_FILE; layer is -1 for modules that are new or have to move
+typedef struct {
+    int* layer;
+    int* pos;
+    double* y;
+} LayoutSeed;
+
+// Column widths and row counts of a module box: inputs | name | outputs
+typedef struct {
+    int n_in, n_out;
+    double in_w, name_w, out_w;
+} ModuleShape;
+
+void module_shape(Module* m, ModuleShape* s) {
+    size_t in_len = 0, out_len = 0;
+    s->n_in = s->n_out = 0;
+    for (Port* p = m->ports; p; p = p->next) {
+        size_t len = strlen(p->name);
+        if (p->dir == DIR_IN) { s->n_in++; if (len > in_len) in_len = len; }
+        else if (p->dir == DIR_OUT) { s->n_out++; if (len > out_len) out_len = len; }
+    }
+    s->in_w = s->n_in ? in_len * CHAR_W + 12 : 0;
+    s->out_w = s->n_out ? out_len * CHAR_W + 12 : 0;
+    s->name_w = strlen(m->name) * (CHAR_W + 1) + 20;
+}
+
+// Centre of the k-th input (or output) row of a module placed in the layout
+double port_row_y(Layout* lay, int node, int n_rows, int k) {
+    double top = lay->y[node] + (lay->h[node] - n_rows * ROW_H) / 2;
+    return top + (k + 0.5) * ROW_H;
+}
+
+// Position of a port among the ports of the same direction, or -1
+int port_row(Module* m, Port* target) {
+    int k = 0;
+    for (Port* p = m->ports; p; p = p->next) {
+        if (p == target) return k;
+        if (p->dir == target->dir) k++;
+    }
+    return -1;
+}
+
+int pair_cmp(const void* a, const void* b) {
+    const Pair* x = (const Pair*)a;
+    const Pair* y = (const Pair*)b;
+    if (x->from != y->from) return x->from < y->from ? -1 : 1;
+    if (x->to != y->to) return x->to < y->to ? -1 : 1;
+    return 0;
+}
+
+int layout_find_pair(Layout* lay, int from, int to) {
+    Pair key = { from, to };
+    Pair* hit = (Pair*)bsearch(&key, lay->pairs, lay->n_pairs, sizeof(Pair), pair_cmp);
+    return hit ? (int)(hit - lay->pairs) : -1;
+}
+
+// Sort context for ordering a layer by barycentre (qsort has no user data)
+static double* sort_key;
+static int* sort_pos;
+
+int barycentre_cmp(const void* a, const void* b) {
+    int u = *(const int*)a, v = *(const int*)b;
+    if (sort_key[u] != sort_key[v]) return sort_key[u] < sort_key[v] ? -1 : 1;
+    return sort_pos[u] - sort_pos[v];
+}
+
+// Reorders one layer by the mean position of its neighbours in the
+// adjacent layer; nodes without neighbours keep their current slot.
+void layout_order_layer(Layout* lay, int l, int* adj_off, int* adj, double* key) {
+    int* nodes = lay->layer_nodes + lay->layer_off[l];
+    int count = lay->layer_off[l + 1] - lay->layer_off[l];
+    for (int i = 0; i < count; i++) {
+        int v = nodes[i];
+        int deg = adj_off[v + 1] - adj_off[v];
+        if (deg == 0) { key[v] = lay->pos[v]; continue; }
+        double sum = 0;
+        for (int e = adj_off[v]; e < adj_off[v + 1]; e++) sum += lay->pos[adj[e]];
+        key[v] = sum / deg;
+    }
+    sort_key = key;
+    sort_pos = lay->pos;
+    qsort(nodes, count, sizeof(int), barycentre_cmp);
+    for (int i = 0; i < count; i++) lay->pos[nodes[i]] = i;
+}
+
+// Places one layer as close as possible to the desired tops without
+// overlapping: a top-down and a bottom-up packing, averaged. On a warm
+// start only the top-down packing is used and dummy nodes just take their
+// desired spot, so known modules stay put and new ones are pushed below.
+void layout_place_layer(Layout* lay, int l, double* want, double* fwd, double* bwd) {
+    int* all = lay->layer_nodes + lay->layer_off[l];
+    int total = lay->layer_off[l + 1] - lay->layer_off[l];
+    if (total == 0) return;
+
+    int* nodes = all;
+    int count = total;
+    if (lay->fixed_y) {
+        nodes = (int*)xcalloc(total, sizeof(int));
+        count = 0;
+        for (int i = 0; i < total; i++) {
+            if (all[i] < lay->n_mods) nodes[count++] = all[i];
+            else lay->y[all[i]] = want[all[i]];
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        int v = nodes[i];
+        fwd[i] = want[v];
+        if (i > 0) {
+            int u = nodes[i - 1];
+            double min_y = fwd[i - 1] + lay->h[u] + NODE_SEP;
+            if (fwd[i] < min_y) fwd[i] = min_y;
+        }
+    }
+    for (int i = count - 1; i >= 0; i--) {
+        int v = nodes[i];
+        bwd[i] = want[v];
+        if (i < count - 1) {
+            double max_y = bwd[i + 1] - lay->h[v] - NODE_SEP;
+            if (bwd[i] > max_y) bwd[i] = max_y;
+        }
+    }
+    for (int i = 0; i < count; i++)
+        lay->y[nodes[i]] = lay->fixed_y ? fwd[i] : (fwd[i] + bwd[i]) / 2;
+    if (nodes != all) free(nodes);
+}
+
+// Moves each node of a layer towards the mean centre of its neighbours;
+// warm-started nodes aim for where they were last time
+void layout_align_layer(Layout* lay, int l, int* adj_off, int* adj, double* want, double* fwd, double* bwd) {
+    for (int i = lay->layer_off[l]; i < lay->layer_off[l + 1]; i++) {
+        int v = lay->layer_nodes[i];
+        int deg = adj_off[v + 1] - adj_off[v];
+        want[v] = lay->y[v];
+        if (lay->fixed_y && lay->fixed_y[v] >= 0) { want[v] = lay->fixed_y[v]; continue; }
+        if (deg == 0) continue;
+        double sum = 0;
+        for (int e = adj_off[v]; e < adj_off[v + 1]; e++) sum += lay->y[adj[e]] + lay->h[adj[e]] / 2;
+        want[v] = sum / deg - lay->h[v] / 2;
+    }
+    layout_place_layer(lay, l, want, fwd, bwd);
+}
+
+// Builds CSR adjacency from an edge list given as parallel arrays
+void build_csr(int n, int m, int* from, int* to, int** off_out, int** adj_out) {
+    int* off = (int*)xcalloc(n + 1, sizeof(int));
+    int* adj = (int*)xcalloc(m, sizeof(int));
+    int* fill = (int*)xcalloc(n, sizeof(int));
+    for (int e = 0; e < m; e++) off[from[e] + 1]++;
+    for (int i = 0; i < n; i++) off[i + 1] += off[i];
+    for (int e = 0; e < m; e++) adj[off[from[e]] + fill[from[e]]++] = to[e];
+    free(fill);
+    *off_out = off;
+    *adj_out = adj;
+}
+
+// Max-heap of (key, node) with lazy deletion, for feedback_order()
+typedef struct { int key, node; } HeapItem;
+typedef struct { HeapItem* items; int size, cap; } Heap;
+
+void heap_push(Heap* hp, int key, int node) {
+    if (hp->size == hp->cap) {
+        hp->cap = hp->cap ? hp->cap * 2 : 256;
+        hp->items = (HeapItem*)xrealloc(hp->items, hp->cap * sizeof(HeapItem));
+    }
+    int i = hp->size++;
+    while (i > 0 && hp->items[(i - 1) / 2].key < key) {
+        hp->items[i] = hp->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    hp->items[i] = (HeapItem){ key, node };
+}
+
+HeapItem heap_pop(Heap* hp) {
+    HeapItem top = hp->items[0];
+    HeapItem last = hp->items[--hp->size];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= hp->size) break;
+        if (c + 1 < hp->size && hp->items[c + 1].key > hp->items[c].key) c++;
+        if (hp->items[c].key <= last.key) break;
+        hp->items[i] = hp->items[c];
+        i = c;
+    }
+    if (hp->size > 0) hp->items[i] = last;
+    return top;
+}
+
+// Eades-Lin-Smyth ordering: peel sinks to the back and sources to the
+// front; when neither is left, take the node with the largest
+// out-degree minus in-degree. Returns each node's rank in the sequence.
+int* feedback_order(int n, int np, Pair* pairs, int* pair_off) {
+    int* in_from = (int*)xcalloc(np, sizeof(int));
+    int* in_to = (int*)xcalloc(np, sizeof(int));
+    for (int i = 0; i < np; i++) { in_from[i] = pairs[i].to; in_to[i] = pairs[i].from; }
+    int *pred_off, *pred;
+    build_csr(n, np, in_from, in_to, &pred_off, &pred);
+    free(in_from);
+    free(in_to);
+
+    int* outd = (int*)xcalloc(n, sizeof(int));
+    int* ind = (int*)xcalloc(n, sizeof(int));
+    bool* gone = (bool*)xcalloc(n, sizeof(bool));
+    int* rank = (int*)xcalloc(n, sizeof(int));
+    int* sinks = (int*)xcalloc(n + np, sizeof(int));
+    int* sources = (int*)xcalloc(n + np, sizeof(int));
+    int n_sinks = 0, n_sources = 0;
+    Heap heap = { NULL, 0, 0 };
+
+    for (int v = 0; v < n; v++) {
+        outd[v] = pair_off[v + 1] - pair_off[v];
+        ind[v] = pred_off[v + 1] - pred_off[v];
+        if (outd[v] == 0) sinks[n_sinks++] = v;
+        else if (ind[v] == 0) sources[n_sources++] = v;
+        else heap_push(&heap, outd[v] - ind[v], v);
+    }
+
+    int front = 0, back = n - 1, left = n;
+    while (left > 0) {
+        int v = -1;
+        bool to_back = false;
+        while (n_sinks > 0 && v < 0) {
+            int c = sinks[--n_sinks];
+            if (!gone[c]) { v = c; to_back = true; }
+        }
+        while (n_sources > 0 && v < 0) {
+            int c = sources[--n_sources];
+            if (!gone[c]) v = c;
+        }
+        while (heap.size > 0 && v < 0) {
+            HeapItem it = heap_pop(&heap);
+            if (!gone[it.node] && it.key == outd[it.node] - ind[it.node]) v = it.node;
+        }
+        if (v < 0) break; // Unreachable: every live node is in some queue
+
+        gone[v] = true;
+        left--;
+        rank[v] = to_back ? back-- : front++;
+        for (int e = pair_off[v]; e < pair_off[v + 1]; e++) {
+            int w = pairs[e].to;
+            if (gone[w]) continue;
+            ind[w]--;
+            if (outd[w] == 0) sinks[n_sinks++] = w;
+            else if (ind[w] == 0) sources[n_sources++] = w;
+            else heap_push(&heap, outd[w] - ind[w], w);
+        }
+        for (int e = pred_off[v]; e < pred_off[v + 1]; e++) {
+            int u = pred[e];
+            if (gone[u]) continue;
+            outd[u]--;
+            if (outd[u] == 0) sinks[n_sinks++] = u;
+            else if (ind[u] == 0) sources[n_sources++] = u;
+            else heap_push(&heap, outd[u] - ind[u], u);
+        }
+    }
+
+    free(pred_off); free(pred);
+    free(outd); free(ind); free(gone);
+    free(sinks); free(sources);
+    free(heap.items);
+    return rank;
+}
+
+int int_cmp(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// True if a placed neighbour of v is on layer l
+bool layer_taken(int v, int l, int* pred_off, int* pred, int* pair_off, Pair* pairs, const int* mod_layer) {
+    for (int e = pred_off[v]; e < pred_off[v + 1]; e++) if (mod_layer[pred[e]] == l) return true;
+    for (int e = pair_off[v]; e < pair_off[v + 1]; e++) if (mod_layer[pairs[e].to] == l) return true;
+    return false;
+}
+
+// Warm-start layering: known modules keep their saved layer. New ones
+// are visited in feedback order (among themselves) and go to the median
+// of the layers their placed neighbours ask for (one right of each
+// predecessor, one left of each successor), or the nearest layer to it
+// that no placed neighbour is on, so no link ends up inside a layer.
+void layout_warm_layers(int n, int np, Pair* pairs, int* pair_off, const int* seed_layer, int* mod_layer) {
+    int* id = (int*)xcalloc(n, sizeof(int));
+    int* node = (int*)xcalloc(n, sizeof(int));
+    int m = 0;
+    for (int v = 0; v < n; v++) {
+        mod_layer[v] = seed_layer[v];
+        id[v] = seed_layer[v] < 0 ? m : -1;
+        if (seed_layer[v] < 0) node[m++] = v;
+    }
+    if (m == 0) { free(id); free(node); return; }
+
+    int* in_from = (int*)xcalloc(np, sizeof(int));
+    int* in_to = (int*)xcalloc(np, sizeof(int));
+    for (int i = 0; i < np; i++) { in_from[i] = pairs[i].to; in_to[i] = pairs[i].from; }
+    int *pred_off, *pred;
+    build_csr(n, np, in_from, in_to, &pred_off, &pred);
+    free(in_from);
+    free(in_to);
+
+    // Links among the new modules, renumbered; pairs stay sorted
+    Pair* sub = (Pair*)xcalloc(np, sizeof(Pair));
+    int* sub_off = (int*)xcalloc(m + 1, sizeof(int));
+    int n_sub = 0;
+    for (int i = 0; i < np; i++) {
+        int a = id[pairs[i].from], b = id[pairs[i].to];
+        if (a < 0 || b < 0) continue;
+        sub[n_sub++] = (Pair){ a, b };
+        sub_off[a + 1]++;
+    }
+    for (int i = 0; i < m; i++) sub_off[i + 1] += sub_off[i];
+    int* rank = feedback_order(m, n_sub, sub, sub_off);
+    for (int i = 0; i < m; i++) id[rank[i]] = node[i]; // id now maps rank -> node
+
+    int max_deg = 0;
+    for (int i = 0; i < m; i++) {
+        int v = node[i];
+        int deg = pred_off[v + 1] - pred_off[v] + pair_off[v + 1] - pair_off[v];
+        if (deg > max_deg) max_deg = deg;
+    }
+    int* want = (int*)xcalloc(max_deg, sizeof(int));
+    for (int r = 0; r < m; r++) {
+        int v = id[r];
+        int k = 0;
+        for (int e = pred_off[v]; e < pred_off[v + 1]; e++)
+            if (mod_layer[pred[e]] >= 0) want[k++] = mod_layer[pred[e]] + 1;
+        for (int e = pair_off[v]; e < pair_off[v + 1]; e++)
+            if (mod_layer[pairs[e].to] > 0) want[k++] = mod_layer[pairs[e].to] - 1;
+        qsort(want, k, sizeof(int), int_cmp);
+        int mid = k ? want[k / 2] : 0;
+
+        // Nearest free layer: mid, mid + 1, mid - 1, mid + 2, ...
+        int l = mid;
+        for (int d = 1; l < 0 || layer_taken(v, l, pred_off, pred, pair_off, pairs, mod_layer); d++)
+            l = d % 2 ? mid + (d + 1) / 2 : mid - d / 2;
+        mod_layer[v] = l;
+    }
+
+    free(want);
+    free(rank);
+    free(sub);
+    free(sub_off);
+    free(pred_off);
+    free(pred);
+    free(id);
+    free(node);
+}
+
+// Puts the known modules of each layer first, in their saved order, and
+// records their saved tops; new modules and dummies follow them until
+// layout_order() slots them in
+void layout_seed_order(Layout* lay, LayoutSeed* seed) {
+    double* key = (double*)xcalloc(lay->n_nodes, sizeof(double));
+    lay->fixed_y = (double*)xcalloc(lay->n_nodes, sizeof(double));
+    double past = 0;
+    for (int v = 0; v < lay->n_mods; v++)
+        if (seed->layer[v] >= 0 && seed->pos[v] >= past) past = seed->pos[v] + 1;
+    for (int v = 0; v < lay->n_nodes; v++) {
+        bool known = v < lay->n_mods && seed->layer[v] >= 0;
+        key[v] = known ? seed->pos[v] : past;
+        lay->fixed_y[v] = known ? seed->y[v] : -1;
+    }
+    sort_key = key;
+    sort_pos = lay->pos;
+    for (int l = 0; l < lay->n_layers; l++) {
+        int* nodes = lay->layer_nodes + lay->layer_off[l];
+        int count = lay->layer_off[l + 1] - lay->layer_off[l];
+        qsort(nodes, count, sizeof(int), barycentre_cmp);
+        for (int i = 0; i < count; i++) lay->pos[nodes[i]] = i;
+    }
+    free(key);
+}
+
+// Builds the layered graph. With a seed from a previous render the
+// known modules keep their layer and their order within it, and the
+// cycle breaking and longest-path layering only run for the new ones.
+Layout* layout_build(Graph* g, LayoutSeed* seed) {
+    Layout* lay = (Layout*)xcalloc(1, sizeof(Layout));
+    int n = g->n;
+    lay->n_mods = n;
+
+    // 1. Distinct module pairs (self-loops are drawn separately)
+    lay->pairs = (Pair*)xcalloc(g->n_edges, sizeof(Pair));
+    for (int u = 0; u < n; u++)
+        for (int e = g->succ_off[u]; e < g->succ_off[u + 1]; e++)
+            if (g->succ[e] != u) lay->pairs[lay->n_pairs++] = (Pair){ u, g->succ[e] };
+    qsort(lay->pairs, lay->n_pairs, sizeof(Pair), pair_cmp);
+    int uniq = 0;
+    for (int i = 0; i < lay->n_pairs; i++)
+        if (uniq == 0 || pair_cmp(&lay->pairs[uniq - 1], &lay->pairs[i]) != 0)
+            lay->pairs[uniq++] = lay->pairs[i];
+    lay->n_pairs = uniq;
+    int np = lay->n_pairs;
+
+    int* pair_off = (int*)xcalloc(n + 1, sizeof(int));
+    for (int i = 0; i < np; i++) pair_off[lay->pairs[i].from + 1]++;
+    for (int i = 0; i < n; i++) pair_off[i + 1] += pair_off[i];
+
+    // 2. Break cycles: flip every pair that points backwards in a greedy
+    // feedback-arc ordering. Unlike DFS back edges this keeps layering
+    // shallow on graphs with many cycles. A warm start takes the layers
+    // first and flips the pairs that point right to left.
+    lay->reversed = (bool*)xcalloc(np, sizeof(bool));
+    int* mod_layer = (int*)xcalloc(n, sizeof(int));
+    if (seed) {
+        layout_warm_layers(n, np, lay->pairs, pair_off, seed->layer, mod_layer);
+        for (int i = 0; i < np; i++)
+            lay->reversed[i] = mod_layer[lay->pairs[i].from] > mod_layer[lay->pairs[i].to];
+    } else {
+        int* rank = feedback_order(n, np, lay->pairs, pair_off);
+        for (int i = 0; i < np; i++)
+            lay->reversed[i] = rank[lay->pairs[i].from] > rank[lay->pairs[i].to];
+        free(rank);
+    }
+
+    // 3. Longest-path layering over the now acyclic pairs (Kahn's order)
+    int* src = (int*)xcalloc(np, sizeof(int));
+    int* dst = (int*)xcalloc(np, sizeof(int));
+    for (int i = 0; i < np; i++) {
+        src[i] = lay->reversed[i] ? lay->pairs[i].to : lay->pairs[i].from;
+        dst[i] = lay->reversed[i] ? lay->pairs[i].from : lay->pairs[i].to;
+    }
+    if (!seed) {
+        int* stack = (int*)xcalloc(n, sizeof(int));
+        int* indeg = (int*)xcalloc(n, sizeof(int));
+        for (int i = 0; i < np; i++) indeg[dst[i]]++;
+        int *dag_off, *dag;
+        build_csr(n, np, src, dst, &dag_off, &dag);
+
+        int head = 0, tail = 0;
+        for (int v = 0; v < n; v++) if (indeg[v] == 0) stack[tail++] = v;
+        while (head < tail) {
+            int u = stack[head++];
+            for (int e = dag_off[u]; e < dag_off[u + 1]; e++) {
+                int v = dag[e];
+                if (mod_layer[u] + 1 > mod_layer[v]) mod_layer[v] = mod_layer[u] + 1;
+                if (--indeg[v] == 0) stack[tail++] = v;
+            }
+        }
+        free(indeg);
+        free(stack);
+        free(dag_off);
+        free(dag);
+    }
+
+    // 4. Dummy nodes, one per layer crossed by a long edge. Edges spanning
+    // more than MAX_DUMMY_SPAN layers are drawn direct instead: on big
+    // models they would otherwise dominate the node count.
+    int n_nodes = n, n_links = 0;
+    lay->chain_off = (int*)xcalloc(np + 1, sizeof(int));
+    for (int i = 0; i < np; i++) {
+        int span = mod_layer[dst[i]] - mod_layer[src[i]];
+        if (span > MAX_DUMMY_SPAN) {
+            lay->chain_off[i + 1] = lay->chain_off[i] + 2;
+            continue;
+        }
+        n_nodes += span - 1;
+        n_links += span;
+        lay->chain_off[i + 1] = lay->chain_off[i] + span + 1;
+    }
+    lay->n_nodes = n_nodes;
+    lay->layer = (int*)xcalloc(n_nodes, sizeof(int));
+    lay->pos = (int*)xcalloc(n_nodes, sizeof(int));
+    lay->x = (double*)xcalloc(n_nodes, sizeof(double));
+    lay->y = (double*)xcalloc(n_nodes, sizeof(double));
+    lay->w = (double*)xcalloc(n_nodes, sizeof(double));
+    lay->h = (double*)xcalloc(n_nodes, sizeof(double));
+    memcpy(lay->layer, mod_layer, n * sizeof(int));
+    free(mod_layer);
+
+    lay->chain = (int*)xcalloc(lay->chain_off[np], sizeof(int));
+    int* link_from = (int*)xcalloc(n_links, sizeof(int));
+    int* link_to = (int*)xcalloc(n_links, sizeof(int));
+    int next_dummy = n, k = 0;
+    for (int i = 0; i < np; i++) {
+        int* c = lay->chain + lay->chain_off[i];
+        int len = lay->chain_off[i + 1] - lay->chain_off[i];
+        c[0] = src[i];
+        for (int j = 1; j < len - 1; j++) {
+            c[j] = next_dummy++;
+            lay->layer[c[j]] = lay->layer[src[i]] + j;
+        }
+        c[len - 1] = dst[i];
+        if (lay->layer[dst[i]] - lay->layer[src[i]] > MAX_DUMMY_SPAN) continue;
+        for (int j = 0; j + 1 < len; j++) {
+            link_from[k] = c[j];
+            link_to[k] = c[j + 1];
+            k++;
+        }
+    }
+    free(src);
+    free(dst);
+    free(pair_off);
+    build_csr(n_nodes, n_links, link_from, link_to, &lay->down_off, &lay->down);
+    build_csr(n_nodes, n_links, link_to, link_from, &lay->up_off, &lay->up);
+    free(link_from);
+    free(link_to);
+
+    // 5. Bucket nodes by layer, initially in creation order
+    for (int v = 0; v < n_nodes; v++)
+        if (lay->layer[v] + 1 > lay->n_layers) lay->n_layers = lay->layer[v] + 1;
+    lay->layer_off = (int*)xcalloc(lay->n_layers + 1, sizeof(int));
+    lay->layer_nodes = (int*)xcalloc(n_nodes, sizeof(int));
+    for (int v = 0; v < n_nodes; v++) lay->layer_off[lay->layer[v] + 1]++;
+    for (int l = 0; l < lay->n_layers; l++) lay->layer_off[l + 1] += lay->layer_off[l];
+    int* fill = (int*)xcalloc(lay->n_layers, sizeof(int));
+    for (int v = 0; v < n_nodes; v++) {
+        int l = lay->layer[v];
+        lay->pos[v] = fill[l]++;
+        lay->layer_nodes[lay->layer_off[l] + lay->pos[v]] = v;
+    }
+    free(fill);
+    if (seed) layout_seed_order(lay, seed);
+    return lay;
+}
+
+// Warm start: known nodes keep their order. In one downward sweep each
+// new module or dummy gets the mean top of its neighbours in the layer
+// before (or, failing that, of its known neighbours in the layer after)
+// and is merged in among the known nodes, which are keyed by their
+// saved top. Nodes with no placed neighbour go to the bottom.
+void layout_order_warm(Layout* lay) {
+    double* key = (double*)xcalloc(lay->n_nodes, sizeof(double));
+    int* merged = (int*)xcalloc(lay->n_nodes, sizeof(int));
+    for (int l = 0; l < lay->n_layers; l++) {
+        int* nodes = lay->layer_nodes + lay->layer_off[l];
+        int count = lay->layer_off[l + 1] - lay->layer_off[l];
+        int known = 0;
+        double bottom = 0;
+        for (int i = 0; i < count; i++) {
+            int v = nodes[i];
+            if (lay->fixed_y[v] >= 0) {
+                key[v] = lay->fixed_y[v];
+                if (key[v] >= bottom) bottom = key[v] + 1;
+                known++;
+                continue;
+            }
+            double sum = 0;
+            int deg = 0;
+            for (int e = lay->up_off[v]; e < lay->up_off[v + 1]; e++, deg++) sum += key[lay->up[e]];
+            for (int e = lay->down_off[v]; deg == 0 && e < lay->down_off[v + 1]; e++) {
+                int w = lay->down[e];
+                if (lay->fixed_y[w] >= 0) { sum += lay->fixed_y[w]; deg++; }
+            }
+            key[v] = deg ? sum / deg : -1;
+        }
+        if (known == count) continue;
+
+        // Known nodes lead the layer (see layout_seed_order); sort the rest
+        int* fresh = nodes + known;
+        int n_fresh = count - known;
+        for (int i = 0; i < n_fresh; i++)
+            if (key[fresh[i]] < 0) key[fresh[i]] = bottom;
+        sort_key = key;
+        sort_pos = lay->pos;
+        qsort(fresh, n_fresh, sizeof(int), barycentre_cmp);
+        int a = 0, b = 0, k = 0;
+        while (a < known || b < n_fresh)
+            merged[k++] = b == n_fresh || (a < known && key[nodes[a]] <= key[fresh[b]]) ? nodes[a++] : fresh[b++];
+        for (int i = 0; i < count; i++) {
+            nodes[i] = merged[i];
+            lay->pos[nodes[i]] = i;
+        }
+    }
+    free(merged);
+    free(key);
+}
+
+// Barycentric crossing reduction, alternating downward and upward sweeps
+void layout_order(Layout* lay) {
+    if (lay->fixed_y) { layout_order_warm(lay); return; }
+    double* key = (double*)xcalloc(lay->n_nodes, sizeof(double));
+    for (int it = 0; it < LAYOUT_SWEEPS; it++) {
+        if (it % 2 == 0) {
+            for (int l = 1; l < lay->n_layers; l++)
+                layout_order_layer(lay, l, lay->up_off, lay->up, key);
+        } else {
+            for (int l = lay->n_layers - 2; l >= 0; l--)
+                layout_order_layer(lay, l, lay->down_off, lay->down, key);
+        }
+    }
+    free(key);
+}
+
+// Sizes every node, stacks layers into columns, then pulls nodes toward
+// their neighbours for straighter edges
+void layout_coords(Layout* lay, Graph* g) {
+    for (int v = 0; v < lay->n_nodes; v++) {
+        if (v < lay->n_mods) {
+            ModuleShape s;
+            module_shape(g->mods[v], &s);
+            int rows = s.n_in > s.n_out ? s.n_in : s.n_out;
+            lay->w[v] = s.in_w + s.name_w + s.out_w;
+            lay->h[v] = rows * ROW_H > NAME_H ? rows * ROW_H : NAME_H;
+        } else {
+            lay->w[v] = 0;
+            lay->h[v] = 0;
+        }
+    }
+
+    double col_x = MARGIN;
+    for (int l = 0; l < lay->n_layers; l++) {
+        double col_w = 0;
+        for (int i = lay->layer_off[l]; i < lay->layer_off[l + 1]; i++) {
+            int v = lay->layer_nodes[i];
+            if (lay->w[v] > col_w) col_w = lay->w[v];
+        }
+        double y = 0;
+        for (int i = lay->layer_off[l]; i < lay->layer_off[l + 1]; i++) {
+            int v = lay->layer_nodes[i];
+            lay->x[v] = col_x + (col_w - lay->w[v]) / 2;
+            lay->y[v] = y;
+            y += lay->h[v] + NODE_SEP;
+        }
+        col_x += col_w + RANK_SEP;
+    }
+
+    double* want = (double*)xcalloc(lay->n_nodes, sizeof(double));
+    double* fwd = (double*)xcalloc(lay->n_nodes, sizeof(double));
+    double* bwd = (double*)xcalloc(lay->n_nodes, sizeof(double));
+    if (lay->fixed_y) {
+        // Warm start: one top-down pass from the first layer, known nodes
+        // go back to their old places and the rest fit in around them
+        for (int l = 0; l < lay->n_layers; l++)
+            layout_align_layer(lay, l, lay->up_off, lay->up, want, fwd, bwd);
+    }
+    for (int pass = 0; !lay->fixed_y && pass < COORD_PASSES; pass++) {
+        if (pass % 2 == 0) {
+            for (int l = 1; l < lay->n_layers; l++)
+                layout_align_layer(lay, l, lay->up_off, lay->up, want, fwd, bwd);
+        } else {
+            for (int l = lay->n_layers - 2; l >= 0; l--)
+                layout_align_layer(lay, l, lay->down_off, lay->down, want, fwd, bwd);
+        }
+    }
+    free(want);
+    free(fwd);
+    free(bwd);
+
+    // Shift everything into view and record the canvas size
+    double min_y = 0, max_x = 0, max_y = 0;
+    for (int v = 0; v < lay->n_nodes; v++)
+        if (v == 0 || lay->y[v] < min_y) min_y = lay->y[v];
+    double shift = MARGIN - min_y;
+    if (lay->fixed_y && shift < 0) shift = 0; // Keep known nodes where they were
+    for (int v = 0; v < lay->n_nodes; v++) {
+        lay->y[v] += shift;
+        if (lay->x[v] + lay->w[v] > max_x) max_x = lay->x[v] + lay->w[v];
+        if (lay->y[v] + lay->h[v] > max_y) max_y = lay->y[v] + lay->h[v];
+    }
+    lay->width = max_x + MARGIN;
+    lay->height = max_y + MARGIN;
+}
+
+// Positions are kept between renders so an edit only places what changed.
+// One line per module: layer, slot, top, name.
+bool layout_save(Layout* lay, Graph* g, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# links layout v1\n");
+    for (int v = 0; v < g->n; v++)
+        fprintf(f, "%d\t%d\t%.1f\t%s\n", lay->layer[v], lay->pos[v], lay->y[v], g->mods[v]->name);
+    return fclose_counted(f) == 0;
+}
+
+void layout_seed_free(LayoutSeed* seed) {
+    free(seed->layer);
+    free(seed->pos);
+    free(seed->y);
+    seed->layer = seed->pos = NULL;
+    seed->y = NULL;
+}
+
+// Reads the placement of a previous render. A module linked to another
+// on its own saved layer has to move, so the target of such a link is
+// left to be placed afresh. Returns the number of modules reused.
+int layout_warm_start(LayoutSeed* seed, Graph* g, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+
+    int n = g->n;
+    seed->layer = (int*)xcalloc(n, sizeof(int));
+    seed->pos = (int*)xcalloc(n, sizeof(int));
+    seed->y = (double*)xcalloc(n, sizeof(double));
+    for (int v = 0; v < n; v++) seed->layer[v] = -1;
+
+    char line[MAX_STR + 64];
+    while (fgets(line, sizeof(line), f)) {
+        int layer, pos, name_at = 0;
+        double y;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%d\t%d\t%lf\t%n", &layer, &pos, &y, &name_at) != 3 || name_at == 0) continue;
+        if (layer < 0 || layer >= n || pos < 0 || !(y >= 0 && y < 1e10)) continue; // Damaged line
+        char* name = line + name_at;
+        name[strcspn(name, "\r\n")] = '\0';
+
+        Module* m = get_module(name, false);
+        if (!m || g->node_of[m->idx] < 0) continue;
+        int v = g->node_of[m->idx];
+        seed->layer[v] = layer;
+        seed->pos[v] = pos;
+        seed->y[v] = y;
+    }
+    fclose(f);
+
+    int reused = 0;
+    for (int u = 0; u < n; u++) {
+        if (seed->layer[u] < 0) continue;
+        for (int e = g->succ_off[u]; e < g->succ_off[u + 1]; e++) {
+            int v = g->succ[e];
+            if (v != u && seed->layer[v] == seed->layer[u]) seed->layer[v] = -1;
+        }
+    }
+    for (int v = 0; v < n; v++) if (seed->layer[v] >= 0) reused++;
+    if (reused == 0) layout_seed_free(seed);
+    return reused;
+}
+
+void layout_free(Layout* lay) {
+    if (!lay) return;
+    free(lay->layer); free(lay->pos);
+    free(lay->x); free(lay->y); free(lay->w); free(lay->h);
+    free(lay->layer_off); free(lay->layer_nodes);
+    free(lay->up_off); free(lay->up);
+    free(lay->down_off); free(lay->down);
+    free(lay->pairs); free(lay->reversed);
+    free(lay->chain_off); free(lay->chain);
+    free(lay->fixed_y);
+    free(lay);
+}
+
+// Full pipeline, warm-started from the saved layout unless 'fresh'
+Layout* layout_run(Graph* g, bool fresh, int* reused) {
+    LayoutSeed seed = { 0 };
+    TraceSpan span = trace_begin("layout_warm_start", "layout");
+    *reused = fresh ? 0 : layout_warm_start(&seed, g, LAYOUT_FILE);
+    trace_end(span);
+    span = trace_begin("layout_build", "layout");
+    Layout* lay = layout_build(g, *reused ? &seed : NULL);
+    layout_seed_free(&seed);
+    trace_end(span);
+    span = trace_begin("layout_order", "layout");
+    layout_order(lay);
+    trace_end(span);
+    span = trace_begin("layout_coords", "layout");
+    layout_coords(lay, g);
+    trace_end(span);
+    return lay;
+}
+
+// --- SVG Writer ---
+
+void svg_text(FILE* f, const char* s) {
+    for (; *s; s++) {
+        switch (*s) {
+            case '<': fputs("&lt;", f); break;
+            case '>': fputs("&gt;", f); break;
+            case '&': fputs("&amp;", f); break;
+            case '"': fputs("&quot;", f); break;
+            default: fputc(*s, f);
+        }
+    }
+}
+
+void svg_port_cell(FILE* f, double x, double y, double w, const char* name) {
+    fprintf(f, "  <rect class=\"port\" x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%.1f\"/>\n",
+            x, y, w, ROW_H);
+    fprintf(f, "  <text x=\"%.1f\" y=\"%.1f\">", x + w / 2, y + ROW_H / 2 + 4);
+    svg_text(f, name);
+    fprintf(f, "</text>\n");
+}
+
+// Points of the link from the k-th output of node u: the port, the dummy
+// nodes of the pair's chain, then the target port. Returns the number of
+// points and sets *target, or returns 0 when the link goes nowhere.
+// Self-loops give just the two endpoints.
+#define EDGE_MAX_POINTS (MAX_DUMMY_SPAN + 2)
+
+int edge_route(Graph* g, Layout* lay, int u, int n_out, int k, Port* p, double* pts, int* target) {
+    if (p->dest_module[0] == '\0') return 0;
+    Module* dm = get_module(p->dest_module, false);
+    if (!dm || g->node_of[dm->idx] < 0) return 0;
+    int v = g->node_of[dm->idx];
+    *target = v;
+
+    int n = 0;
+    pts[2 * n] = lay->x[u] + lay->w[u];
+    pts[2 * n++ + 1] = port_row_y(lay, u, n_out, k);
+    int pi = u == v ? -1 : layout_find_pair(lay, u, v);
+    if (pi >= 0) {
+        int* c = lay->chain + lay->chain_off[pi];
+        int len = lay->chain_off[pi + 1] - lay->chain_off[pi];
+        for (int j = 1; j < len - 1 && n < EDGE_MAX_POINTS - 1; j++) {
+            int d = lay->reversed[pi] ? c[len - 1 - j] : c[j];
+            pts[2 * n] = lay->x[d];
+            pts[2 * n++ + 1] = lay->y[d];
+        }
+    }
+    ModuleShape sv;
+    module_shape(dm, &sv);
+    Port* dp = get_port(dm, p->dest_port, false);
+    pts[2 * n] = lay->x[v];
+    pts[2 * n + 1] = lay->y[v] + lay->h[v] / 2;
+    if (dp && dp->dir == DIR_IN) pts[2 * n + 1] = port_row_y(lay, v, sv.n_in, port_row(dm, dp));
+    return n + 1;
+}
+
+bool native_write_svg(Graph* g, Layout* lay, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.0f\" height=\"%.0f\" viewBox=\"0 0 %.0f %.0f\">\n",
+            lay->width, lay->height, lay->width, lay->height);
+    fprintf(f, "<defs><marker id=\"arrow\" viewBox=\"0 0 10 10\" refX=\"10\" refY=\"5\" markerWidth=\"8\" markerHeight=\"8\" orient=\"auto\">"
+               "<path d=\"M0,0 L10,5 L0,10 z\"/></marker></defs>\n");
+    fprintf(f, "<style>text{font-family:Arial;font-size:12px;text-anchor:middle}"
+               ".name{font-weight:bold}.port{fill:#ffffff;stroke:#000000}"
+               ".module{fill:#f0f0f0;stroke:#000000}"
+               ".edge{fill:none;stroke:#000000;marker-end:url(#arrow)}</style>\n");
+    fprintf(f, "<rect width=\"100%%\" height=\"100%%\" fill=\"#ffffff\"/>\n");
+
+    // Edges first so boxes sit on top of them
+    double pts[2 * EDGE_MAX_POINTS];
+    for (int u = 0; u < g->n; u++) {
+        ModuleShape su;
+        module_shape(g->mods[u], &su);
+        int out_k = 0;
+        for (Port* p = g->mods[u]->ports; p; p = p->next) {
+            if (p->dir != DIR_OUT) continue;
+            int v, k = out_k++;
+            int n = edge_route(g, lay, u, su.n_out, k, p, pts, &v);
+            if (n == 0) continue;
+            if (u == v) {
+                fprintf(f, "  <path class=\"edge\" d=\"M%.1f,%.1f C%.1f,%.1f %.1f,%.1f %.1f,%.1f\"/>\n",
+                        pts[0], pts[1], pts[0] + 40, lay->y[u] - 40, pts[2] - 40, lay->y[u] - 40, pts[2], pts[3]);
+                continue;
+            }
+            fprintf(f, "  <polyline class=\"edge\" points=\"");
+            for (int j = 0; j < n; j++) fprintf(f, j ? " %.1f,%.1f" : "%.1f,%.1f", pts[2 * j], pts[2 * j + 1]);
+            fprintf(f, "\"/>\n");
+        }
+    }
+
+    for (int u = 0; u < g->n; u++) {
+        Module* m = g->mods[u];
+        ModuleShape s;
+        module_shape(m, &s);
+        double x = lay->x[u], y = lay->y[u], h = lay->h[u];
+
+        fprintf(f, "<g>\n");
+        int in_k = 0, out_k = 0;
+        for (Port* p = m->ports; p; p = p->next) {
+            if (p->dir == DIR_IN)
+                svg_port_cell(f, x, port_row_y(lay, u, s.n_in, in_k++) - ROW_H / 2, s.in_w, p->name);
+            else if (p->dir == DIR_OUT)
+                svg_port_cell(f, x + s.in_w + s.name_w, port_row_y(lay, u, s.n_out, out_k++) - ROW_H / 2, s.out_w, p->name);
+        }
+        double ny = y + (h - NAME_H) / 2;
+        fprintf(f, "  <rect class=\"module\" x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%.1f\"/>\n",
+                x + s.in_w, ny, s.name_w, NAME_H);
+        fprintf(f, "  <text class=\"name\" x=\"%.1f\" y=\"%.1f\">", x + s.in_w + s.name_w / 2, ny + NAME_H / 2 + 4);
+        svg_text(f, m->name);
+        fprintf(f, "</text>\n</g>\n");
+    }
+
+    fprintf(f, "</svg>\n");
+    return fclose_counted(f) == 0;
+}
+
+// --- Render Cache ---
+
+// Rendered outputs are kept in CACHE_DIR under the hash of the DOT text
+// that produced them, so re-rendering an unchanged (or recently seen)
+// graph is a file copy instead of a Graphviz run.
+
+void cache_path(char* out, size_t size, uint64_t key, const char* ext) {
+    snprintf(out, size, "%s/%016llx.%.*s", CACHE_DIR, (unsigned long long)key, MAX_STR - 1, ext);
+}
+
+bool file_exists(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// Copies through a temporary file renamed into place, so a copy cut
+// short (a cancelled render) never leaves a truncated cache entry or image
+bool copy_file(const char* from, const char* to) {
+    FILE* in = fopen(from, "rb");
+    if (!in) return false;
+    char tmp[MAX_STR * 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%ld", to, (long)getpid());
+    FILE* out = fopen(tmp, "wb");
+    if (!out) { fclose(in); return false; }
+
+    char buf[65536];
+    size_t n;
+    bool ok = true;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (fwrite(buf, 1, n, out) != n) { ok = false; break; }
+    }
+    if (ferror(in)) ok = false;
+    fclose(in);
+    if (fclose_counted(out) != 0) ok = false;
+    if (ok && rename(tmp, to) != 0) ok = false;
+    if (!ok) remove(tmp);
+    return ok;
+}
+
+// True if 'path' already holds exactly these bytes
+bool file_matches(const char* path, const char* data, size_t len) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    char buf[65536];
+    size_t off = 0, n;
+    bool same = true;
+    while (same && (n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        if (off + n > len || memcmp(buf, data + off, n) != 0) same = false;
+        off += n;
+    }
+    fclose(f);
+    return same && off == len;
+}
+
+// Drops the least recently used entries once the cache grows past its cap.
+// Hits refresh an entry's mtime, so recent variants stay resident.
+void cache_prune() {
+    DIR* d = opendir(CACHE_DIR);
+    if (!d) return;
+
+    typedef struct { char name[MAX_STR]; time_t mtime; } Entry;
+    Entry* entries = NULL;
+    int n = 0, cap = 0;
+    struct dirent* de;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.' || strlen(de->d_name) >= MAX_STR) continue;
+        char path[sizeof(CACHE_DIR) + sizeof(de->d_name)];
+        snprintf(path, sizeof(path), "%s/%s", CACHE_DIR, de->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            entries = (Entry*)xrealloc(entries, cap * sizeof(Entry));
+        }
+        strcpy(entries[n].name, de->d_name);
+        entries[n].mtime = st.st_mtime;
+        n++;
+    }
+    closedir(d);
+
+    while (n > CACHE_MAX_FILES) {
+        int oldest = 0;
+        for (int i = 1; i < n; i++)
+            if (entries[i].mtime < entries[oldest].mtime) oldest = i;
+        char path[MAX_STR * 2];
+        snprintf(path, sizeof(path), "%s/%s", CACHE_DIR, entries[oldest].name);
+        remove(path);
+        entries[oldest] = entries[--n];
+    }
+    free(entries);
+}
+
+// Lays the graph out once and renders every requested format from that
+// single layout: dot pairs each -T with the -o that follows it.
+// Returns dot's exit status, or -1 if it could not be started.
+int run_graphviz(const char* dot_file, char formats[][MAX_STR], int n_formats) {
+    char t_args[MAX_FORMATS][MAX_STR + 2];
+    char o_args[MAX_FORMATS][MAX_STR + 8];
+    char* args[4 + 2 * MAX_FORMATS];
+    int n = 0;
+
+    args[n++] = "dot";
+    for (int i = 0; i < n_formats; i++) {
+        snprintf(t_args[i], sizeof(t_args[i]), "-T%s", formats[i]);
+        snprintf(o_args[i], sizeof(o_args[i]), "-ograph.%s", formats[i]);
+        args[n++] = t_args[i];
+        args[n++] = o_args[i];
+    }
+    args[n++] = (char*)dot_file;
+    args[n] = NULL;
+
+    // The phase and span close on every path, so a failed run still shows
+    ProfMark start = prof_mark();
+    TraceSpan span = trace_begin("graphviz", "child");
+    int rc = -1;
+    pid_t pid;
+    int err = posix_spawnp(&pid, "dot", NULL, NULL, args, environ);
+    if (err != 0) {
+        printf("Error: Could not run Graphviz 'dot' (%s).\n", strerror(err));
+    } else {
+        int status = 0;
+        pid_t done;
+        while ((done = waitpid(pid, &status, 0)) < 0 && errno == EINTR) {}
+        if (done >= 0 && WIFEXITED(status)) rc = WEXITSTATUS(status);
+    }
+    trace_end(span);
+    prof_end(PHASE_GRAPHVIZ, start);
+    return rc;
+}
+
+// Splits "svg,png" into format names; only plain alphanumerics are accepted
+// since each one becomes part of an output file name.
+int parse_formats(const char* spec, char formats[][MAX_STR]) {
+    int n = 0;
+    const char* s = spec;
+    while (*s && n < MAX_FORMATS) {
+        size_t len = strcspn(s, ",");
+        if (len > 0 && len < MAX_STR) {
+            bool ok = true;
+            for (size_t i = 0; i < len; i++) {
+                char c = s[i];
+                if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))) ok = false;
+            }
+            if (ok) {
+                memcpy(formats[n], s, len);
+                formats[n][len] = '\0';
+                n++;
+            } else {
+                printf("Warning: Ignoring invalid format '%.*s'.\n", (int)len, s);
+            }
+        }
+        s += len;
+        if (*s == ',') s++;
+    }
+    return n;
+}
+
+// Emits one module as an HTML-table node: inputs | name | outputs
+void write_dot_module(FILE* f, Module* m) {
+    fprintf(f, "  %s [label=<\n", m->name);
+    
+    // --- OUTER TABLE (Structure Only) ---
+    // border=0 ensures no outer frame.
+    fprintf(f, "   <table border=\"0\" cellborder=\"0\" cellspacing=\"0\" cellpadding=\"0\">\n");
+    fprintf(f, "    <tr>\n");
+
+    // --- 1. LEFT COLUMN: INPUTS ---
+    fprintf(f, "      <td>\n"); 
+    
+    bool has_in = false;
+    Port* p = m->ports;
+    while(p) { if(p->dir == DIR_IN) has_in = true; p = p->next; }
+
+    if (has_in) {
+        // Inner table: Handles the border and white background
+        fprintf(f, "        <table border=\"0\" cellborder=\"1\" cellspacing=\"0\" cellpadding=\"4\" bgcolor=\"#ffffff\">\n");
+        p = m->ports;
+        while(p) {
+            if(p->dir == DIR_IN) {
+                fprintf(f, "          <tr><td port=\"%s\">%s</td></tr>\n", p->name, p->name);
+            }
+            p = p->next;
+        }
+        fprintf(f, "        </table>\n");
+    }
+    fprintf(f, "      </td>\n");
+
+    // --- 2. MIDDLE COLUMN: MODULE NAME ---
+    // FIX: Moved border/bgcolor from <TD> to the <TABLE>. 
+    // This fixes the "mismatched tag" error on older/strict parsers.
+    fprintf(f, "      <td>\n");
+    fprintf(f, "        <table border=\"1\" cellborder=\"0\" cellspacing=\"0\" cellpadding=\"8\" bgcolor=\"#f0f0f0\">\n");
+    fprintf(f, "          <tr><td><b>%s</b></td></tr>\n", m->name);
+    fprintf(f, "        </table>\n");
+    fprintf(f, "      </td>\n");
+
+    // --- 3. RIGHT COLUMN: OUTPUTS ---
+    fprintf(f, "      <td>\n");
+    
+    bool has_out = false;
+    p = m->ports;
+    while(p) { if(p->dir == DIR_OUT) has_out = true; p = p->next; }
+
+    if (has_out) {
+        // Inner table: Handles the border and white background
+        fprintf(f, "        <table border=\"0\" cellborder=\"1\" cellspacing=\"0\" cellpadding=\"4\" bgcolor=\"#ffffff\">\n");
+        p = m->ports;
+        while(p) {
+            if(p->dir == DIR_OUT) {
+                fprintf(f, "          <tr><td port=\"%s\">%s</td></tr>\n", p->name, p->name);
+            }
+            p = p->next;
+        }
+        fprintf(f, "        </table>\n");
+    }
+    fprintf(f, "      </td>\n");
+
+    fprintf(f, "    </tr>\n");
+    fprintf(f, "   </table>>];\n\n");
+}
+
+// --- Clusters ---
+
+// Groups modules for 'dot --cluster': by name prefix (up to the first '_'
+// or '.'), by weakly connected component, or by the explicit group
+// attribute. Modules without a group stay outside any cluster.
+
+typedef struct {
+    int n;                  // Number of clusters
+    int* of;                // Module::idx -> cluster, or -1
+    char (*names)[MAX_STR];
+    int* member_off;        // members[member_off[c] .. member_off[c+1]), list order
+    Module** members;
+} Clusters;
+
+int uf_find(int* parent, int x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+// Looks a cluster up by name, adding it if new (open addressing over ids)
+int cluster_intern(Clusters* cl, int** table, size_t* cap, const char* name) {
+    if ((size_t)(cl->n + 1) * 2 > *cap) {
+        size_t new_cap = *cap ? *cap * 2 : 64;
+        int* t = (int*)xcalloc(new_cap, sizeof(int));
+        for (size_t i = 0; i < new_cap; i++) t[i] = -1;
+        for (int c = 0; c < cl->n; c++) {
+            size_t h = fnv1a64(cl->names[c], strlen(cl->names[c])) & (new_cap - 1);
+            while (t[h] >= 0) h = (h + 1) & (new_cap - 1);
+            t[h] = c;
+        }
+        free(*table);
+        *table = t;
+        *cap = new_cap;
+    }
+    size_t h = fnv1a64(name, strlen(name)) & (*cap - 1);
+    while ((*table)[h] >= 0) {
+        if (strcmp(cl->names[(*table)[h]], name) == 0) return (*table)[h];
+        h = (h + 1) & (*cap - 1);
+    }
+    int c = cl->n++;
+    strncpy(cl->names[c], name, MAX_STR - 1);
+    cl->names[c][MAX_STR - 1] = '\0';
+    (*table)[h] = c;
+    return c;
+}
+
+bool clusters_build(const char* mode, Clusters* cl) {
+    if (strcmp(mode, "prefix") != 0 && strcmp(mode, "component") != 0 && strcmp(mode, "group") != 0) {
+        printf("Error: Unknown cluster mode '%s' (expected prefix, component or group).\n", mode);
+        return false;
+    }
+    cl->n = 0;
+    cl->of = (int*)xcalloc(module_count, sizeof(int));
+    cl->names = (char (*)[MAX_STR])xcalloc(module_count, MAX_STR);
+
+    if (strcmp(mode, "component") == 0) {
+        Graph* g = graph_build(NULL);
+        int* parent = (int*)xcalloc(g->n, sizeof(int));
+        for (int i = 0; i < g->n; i++) parent[i] = i;
+        for (int u = 0; u < g->n; u++)
+            for (int e = g->succ_off[u]; e < g->succ_off[u + 1]; e++) {
+                int a = uf_find(parent, u), b = uf_find(parent, g->succ[e]);
+                if (a != b) parent[a < b ? b : a] = a < b ? a : b; // Root = first module
+            }
+        int* comp_of_root = (int*)xcalloc(g->n, sizeof(int));
+        for (int i = 0; i < g->n; i++) comp_of_root[i] = -1;
+        for (int i = 0; i < g->n; i++) {
+            int r = uf_find(parent, i);
+            if (comp_of_root[r] < 0) {
+                comp_of_root[r] = cl->n;
+                snprintf(cl->names[cl->n], MAX_STR, "component %d", cl->n + 1);
+                cl->n++;
+            }
+            cl->of[g->mods[i]->idx] = comp_of_root[r];
+        }
+        free(comp_of_root);
+        free(parent);
+        graph_free(g);
+    } else {
+        int* table = NULL;
+        size_t cap = 0;
+        bool by_prefix = strcmp(mode, "prefix") == 0;
+        for (Module* m = root_modules; m; m = m->next) {
+            char key[MAX_STR];
+            if (by_prefix) {
+                size_t len = strcspn(m->name, "_.");
+                memcpy(key, m->name, len);
+                key[len] = '\0';
+            } else {
+                strcpy(key, m->group);
+            }
+            cl->of[m->idx] = key[0] ? cluster_intern(cl, &table, &cap, key) : -1;
+        }
+        free(table);
+    }
+
+    // A cluster of one module would only put a box around it (or, with
+    // --collapse, rename it), so such modules stay unclustered
+    int* size = (int*)xcalloc(cl->n, sizeof(int));
+    for (int i = 0; i < module_count; i++)
+        if (cl->of[i] >= 0) size[cl->of[i]]++;
+    int kept = 0;
+    for (int c = 0; c < cl->n; c++) {
+        if (size[c] < 2) { size[c] = -1; continue; }
+        if (kept != c) memcpy(cl->names[kept], cl->names[c], MAX_STR);
+        if (strcmp(mode, "component") == 0) snprintf(cl->names[kept], MAX_STR, "component %d", kept + 1);
+        size[c] = kept++; // size now maps old cluster -> new
+    }
+    for (int i = 0; i < module_count; i++)
+        if (cl->of[i] >= 0) cl->of[i] = size[cl->of[i]];
+    cl->n = kept;
+    free(size);
+
+    // Member lists per cluster, keeping module order
+    cl->member_off = (int*)xcalloc(cl->n + 1, sizeof(int));
+    cl->members = (Module**)xcalloc(module_count, sizeof(Module*));
+    for (int i = 0; i < module_count; i++)
+        if (cl->of[i] >= 0) cl->member_off[cl->of[i] + 1]++;
+    for (int c = 0; c < cl->n; c++) cl->member_off[c + 1] += cl->member_off[c];
+    int* fill = (int*)xcalloc(cl->n, sizeof(int));
+    for (Module* m = root_modules; m; m = m->next) {
+        int c = cl->of[m->idx];
+        if (c >= 0) cl->members[cl->member_off[c] + fill[c]++] = m;
+    }
+    free(fill);
+    return true;
+}
+
+void clusters_free(Clusters* cl) {
+    free(cl->of);
+    free(cl->names);
+    free(cl->member_off);
+    free(cl->members);
+}
+
+// Writes a DOT string literal
+void dot_quoted(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '\n') { fputs("\\n", f); continue; }
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// Module-pair edge table: one entry per (src, dst), kept in first-seen
+// order, found through an open-addressing hash on the pair
+#define MAX_EDGE_TYPES 4
+
+typedef struct {
+    int src, dst;
+    int count;
+    int n_types;                        // Distinct types seen (may exceed the list)
+    const char* types[MAX_EDGE_TYPES];
+} PairEdge;
+
+typedef struct {
+    PairEdge* edges;
+    int n, cap;
+    int* table;
+    size_t table_cap;
+} PairMap;
+
+size_t pair_hash(int src, int dst) {
+    uint64_t h = (uint64_t)(uint32_t)src * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t)(uint32_t)dst + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+    return (size_t)(h ^ (h >> 31));
+}
+
+PairEdge* pair_map_get(PairMap* pm, int src, int dst) {
+    if ((size_t)(pm->n + 1) * 2 > pm->table_cap) {
+        size_t new_cap = pm->table_cap ? pm->table_cap * 2 : 256;
+        int* t = (int*)xcalloc(new_cap, sizeof(int));
+        for (size_t i = 0; i < new_cap; i++) t[i] = -1;
+        for (int e = 0; e < pm->n; e++) {
+            size_t h = pair_hash(pm->edges[e].src, pm->edges[e].dst) & (new_cap - 1);
+            while (t[h] >= 0) h = (h + 1) & (new_cap - 1);
+            t[h] = e;
+        }
+        free(pm->table);
+        pm->table = t;
+        pm->table_cap = new_cap;
+    }
+    size_t h = pair_hash(src, dst) & (pm->table_cap - 1);
+    while (pm->table[h] >= 0) {
+        PairEdge* e = &pm->edges[pm->table[h]];
+        if (e->src == src && e->dst == dst) return e;
+        h = (h + 1) & (pm->table_cap - 1);
+    }
+    if (pm->n == pm->cap) {
+        pm->cap = pm->cap ? pm->cap * 2 : 256;
+        pm->edges = (PairEdge*)xrealloc(pm->edges, pm->cap * sizeof(PairEdge));
+    }
+    pm->table[h] = pm->n;
+    PairEdge* e = &pm->edges[pm->n++];
+    memset(e, 0, sizeof(*e));
+    e->src = src;
+    e->dst = dst;
+    return e;
+}
+
+void pair_edge_add(PairEdge* e, const char* type) {
+    e->count++;
+    int listed = e->n_types < MAX_EDGE_TYPES ? e->n_types : MAX_EDGE_TYPES;
+    for (int i = 0; i < listed; i++)
+        if (strcmp(e->types[i], type) == 0) return;
+    if (e->n_types < MAX_EDGE_TYPES) e->types[e->n_types] = type;
+    e->n_types++;
+}
+
+void pair_map_free(PairMap* pm) {
+    free(pm->edges);
+    free(pm->table);
+}
+
+// Line width grows with the log of the number of merged links
+double pair_edge_width(int count) {
+    double w = 1.0;
+    while (count > 1) { w += 1.0; count >>= 1; }
+    return w > 8.0 ? 8.0 : w;
+}
+
+// Collapsed view: each cluster becomes one summary node and the links
+// between two nodes become a single edge labelled with their count
+void write_dot_collapsed(FILE* f, Clusters* cl, const bool* keep) {
+    Module** by_idx = (Module**)xcalloc(module_count, sizeof(Module*));
+    for (Module* m = root_modules; m; m = m->next) by_idx[m->idx] = m;
+
+    for (Module* m = root_modules; m; m = m->next)
+        if ((!keep || keep[m->idx]) && cl->of[m->idx] < 0) write_dot_module(f, m);
+
+    for (int c = 0; c < cl->n; c++) {
+        int count = 0, ports = 0;
+        for (int k = cl->member_off[c]; k < cl->member_off[c + 1]; k++) {
+            Module* cm = cl->members[k];
+            if (keep && !keep[cm->idx]) continue;
+            count++;
+            for (Port* p = cm->ports; p; p = p->next) ports++;
+        }
+        if (count == 0) continue;
+        fprintf(f, "  __cluster_%d [shape=box, style=\"rounded,filled\", fillcolor=\"#f0f0f0\", label=", c);
+        char label[MAX_STR * 2];
+        snprintf(label, sizeof(label), "%s\n%d module%s, %d ports", cl->names[c], count, count == 1 ? "" : "s", ports);
+        dot_quoted(f, label);
+        fprintf(f, "];\n");
+    }
+    fprintf(f, "\n");
+
+    // Endpoint key: a module index, or module_count + cluster
+    PairMap pm = { 0 };
+    for (Module* m = root_modules; m; m = m->next) {
+        if (keep && !keep[m->idx]) continue;
+        for (Port* p = m->ports; p; p = p->next) {
+            if (p->dir != DIR_OUT || p->dest_module[0] == '\0') continue;
+            Module* dm = get_module(p->dest_module, false);
+            if (!dm || (keep && !keep[dm->idx])) continue;
+            int a = cl->of[m->idx] >= 0 ? module_count + cl->of[m->idx] : m->idx;
+            int b = cl->of[dm->idx] >= 0 ? module_count + cl->of[dm->idx] : dm->idx;
+            if (a == b) continue; // Internal to a cluster
+            pair_edge_add(pair_map_get(&pm, a, b), p->type);
+        }
+    }
+    for (int i = 0; i < pm.n; i++) {
+        PairEdge* e = &pm.edges[i];
+        fprintf(f, "  ");
+        for (int side = 0; side < 2; side++) {
+            int key = side == 0 ? e->src : e->dst;
+            if (key >= module_count) fprintf(f, "__cluster_%d", key - module_count);
+            else fprintf(f, "%s", by_idx[key]->name);
+            fprintf(f, side == 0 ? " -> " : "");
+        }
+        fprintf(f, " [label=\"%d\", penwidth=%.1f];\n", e->count, pair_edge_width(e->count));
+    }
+    pair_map_free(&pm);
+    free(by_idx);
+}
+
+// Aggregated view: all links between two modules become one edge,
+// labelled with the number of signals and their types
+void write_dot_aggregated(FILE* f, const bool* keep) {
+    Module** by_idx = (Module**)xcalloc(module_count, sizeof(Module*));
+    for (Module* m = root_modules; m; m = m->next) by_idx[m->idx] = m;
+
+    PairMap pm = { 0 };
+    for (Module* m = root_modules; m; m = m->next) {
+        if (keep && !keep[m->idx]) continue;
+        for (Port* p = m->ports; p; p = p->next) {
+            if (p->dir != DIR_OUT || p->dest_module[0] == '\0') continue;
+            Module* dm = get_module(p->dest_module, false);
+            if (!dm || (keep && !keep[dm->idx])) continue;
+            pair_edge_add(pair_map_get(&pm, m->idx, dm->idx), p->type);
+        }
+    }
+
+    for (int i = 0; i < pm.n; i++) {
+        PairEdge* e = &pm.edges[i];
+        char label[MAX_STR * (MAX_EDGE_TYPES + 1)];
+        int len = snprintf(label, sizeof(label), "%d signal%s", e->count, e->count == 1 ? "" : "s");
+        int listed = e->n_types < MAX_EDGE_TYPES ? e->n_types : MAX_EDGE_TYPES;
+        for (int t = 0; t < listed && len < (int)sizeof(label); t++)
+            len += snprintf(label + len, sizeof(label) - len, "%s%s", t == 0 ? "\n" : ", ", e->types[t]);
+        if (e->n_types > MAX_EDGE_TYPES && len < (int)sizeof(label))
+            snprintf(label + len, sizeof(label) - len, ", ...");
+
+        fprintf(f, "  %s -> %s [label=", by_idx[e->src]->name, by_idx[e->dst]->name);
+        dot_quoted(f, label);
+        fprintf(f, ", weight=%d, penwidth=%.1f];\n", e->count, pair_edge_width(e->count));
+    }
+    pair_map_free(&pm);
+    free(by_idx);
+}
+
+// Writes graph.dot (if changed) and renders it, serving cached outputs
+// where possible. Takes ownership of dot_text.
+void render_dot_text(char* dot_text, size_t dot_len, char formats[][MAX_STR], int n_formats, bool use_cache) {
+    // Leave graph.dot untouched when it is already current
+    if (!file_matches("graph.dot", dot_text, dot_len)) {
+        FILE* out = fopen("graph.dot", "w");
+        if (!out) { free(dot_text); return; }
+        TraceSpan span = trace_begin("write graph.dot", "serialize");
+        fwrite(dot_text, 1, dot_len, out);
+        fclose_counted(out);
+        trace_end(span);
+    }
+    uint64_t key = fnv1a64(dot_text, dot_len);
+    free(dot_text);
+
+    if (use_cache) mkdir(CACHE_DIR, 0755);
+
+    // Serve what we can from the cache; render only the rest
+    char missing[MAX_FORMATS][MAX_STR];
+    int n_missing = 0;
+    for (int i = 0; i < n_formats; i++) {
+        char cached[MAX_STR * 2], target[MAX_STR + 8];
+        cache_path(cached, sizeof(cached), key, formats[i]);
+        snprintf(target, sizeof(target), "graph.%.*s", MAX_STR - 1, formats[i]);
+        if (use_cache && file_exists(cached) && copy_file(cached, target)) {
+            utimensat(AT_FDCWD, cached, NULL, 0); // Mark as recently used
+        } else {
+            strcpy(missing[n_missing++], formats[i]);
+        }
+    }
+
+    if (n_missing > 0) {
+        int rc = run_graphviz("graph.dot", missing, n_missing);
+        if (rc != 0) {
+            if (rc > 0) printf("Error: Graphviz 'dot' exited with status %d.\n", rc);
+            return;
+        }
+        if (use_cache) {
+            for (int i = 0; i < n_missing; i++) {
+                char cached[MAX_STR * 2], target[MAX_STR + 8];
+                cache_path(cached, sizeof(cached), key, missing[i]);
+                snprintf(target, sizeof(target), "graph.%.*s", MAX_STR - 1, missing[i]);
+                copy_file(target, cached);
+            }
+            cache_prune();
+        }
+    }
+    for (int i = 0; i < n_formats; i++) printf("Generated graph.%s successfully.\n", formats[i]);
+    if (n_missing == 0) printf("(served from %s)\n", CACHE_DIR);
+}
+
+typedef struct {
+    const char* formats;
+    bool formats_given;
+    const char* engine;     // "dot" (Graphviz) or "native"
+    bool use_cache;
+    const char* focus;      // Only render this module's neighbourhood
+    int depth;
+    bool up, down;          // Which links to follow from the focus
+    const char* cluster;    // prefix | component | group, or NULL
+    bool collapse;          // One summary node per cluster
+    bool aggregate;         // One weighted edge per module pair
+    bool fresh;             // Native engine: ignore the previous layout
+} DotOptions;
+
+bool parse_dot_options(int argc, char* argv[], DotOptions* o) {
+    o->formats = DEFAULT_FORMATS;
+    o->formats_given = false;
+    o->engine = "dot";
+    o->use_cache = true;
+    o->focus = NULL;
+    o->depth = 1;
+    o->up = o->down = false;
+    o->cluster = NULL;
+    o->collapse = false;
+    o->aggregate = false;
+    o->fresh = false;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--no-cache") == 0) o->use_cache = false;
+        else if (strcmp(argv[i], "--formats") == 0 && i + 1 < argc) { o->formats = argv[++i]; o->formats_given = true; }
+        else if (strncmp(argv[i], "--formats=", 10) == 0) { o->formats = argv[i] + 10; o->formats_given = true; }
+        else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) o->engine = argv[++i];
+        else if (strncmp(argv[i], "--engine=", 9) == 0) o->engine = argv[i] + 9;
+        else if (strcmp(argv[i], "--focus") == 0 && i + 1 < argc) o->focus = argv[++i];
+        else if (strncmp(argv[i], "--focus=", 8) == 0) o->focus = argv[i] + 8;
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) o->depth = atoi(argv[++i]);
+        else if (strncmp(argv[i], "--depth=", 8) == 0) o->depth = atoi(argv[i] + 8);
+        else if (strcmp(argv[i], "--up") == 0) o->up = true;
+        else if (strcmp(argv[i], "--down") == 0) o->down = true;
+        else if (strcmp(argv[i], "--cluster") == 0 && i + 1 < argc) o->cluster = argv[++i];
+        else if (strncmp(argv[i], "--cluster=", 10) == 0) o->cluster = argv[i] + 10;
+        else if (strcmp(argv[i], "--collapse") == 0) o->collapse = true;
+        else if (strcmp(argv[i], "--aggregate") == 0) o->aggregate = true;
+        else if (strcmp(argv[i], "--fresh") == 0) o->fresh = true;
+        else { printf("Error: Unknown option for 'dot': %s\n", argv[i]); return false; }
+    }
+    if (strcmp(o->engine, "dot") != 0 && strcmp(o->engine, "native") != 0) {
+        printf("Error: Unknown engine '%s' (expected dot or native).\n", o->engine);
+        return false;
+    }
+    if (o->depth < 0) o->depth = 0;
+    if (!o->up && !o->down) o->up = o->down = true; // Both ways by default
+    if (o->collapse && !o->cluster) o->cluster = "prefix";
+    return true;
+}
+
+// The DOT text for the given options, built in memory (NULL on error)
+char* build_dot_text(DotOptions* opt, const bool* keep, size_t* len) {
+    char* dot_text = NULL;
+    FILE* f = open_memstream(&dot_text, len);
+    if (!f) return NULL;
+
+    fprintf(f, "digraph G {\n");
+    fprintf(f, "  rankdir=LR;\n");
+    
+    // Use polyline to prevent wires from 'floating' or missing ports
+    fprintf(f, "  splines=polyline;\n");
+    
     fprintf(f, "  nodesep=0.8;\n"); 
     fprintf(f, "  ranksep=1.0;\n");
     
@@ -524,105 +3107,1174 @@ void cmd_dot() {
     fprintf(f, "  node [shape=plain, fontname=\"Arial\", fontsize=12];\n");
     fprintf(f, "  edge [fontname=\"Arial\", fontsize=10];\n\n");
     
+    Clusters cl;
+    if (opt->cluster && !clusters_build(opt->cluster, &cl)) {
+        fclose(f);
+        free(dot_text);
+        return NULL;
+    }
+
+    if (opt->collapse) {
+        write_dot_collapsed(f, &cl, keep);
+        fprintf(f, "}\n");
+        fclose(f);
+        clusters_free(&cl);
+        return dot_text;
+    }
+
     Module* m = root_modules;
     while (m) {
-        fprintf(f, "  %s [label=<\n", m->name);
-        
-        // --- OUTER TABLE (Structure Only) ---
-        // border=0 ensures no outer frame.
-        fprintf(f, "   <table border=\"0\" cellborder=\"0\" cellspacing=\"0\" cellpadding=\"0\">\n");
-        fprintf(f, "    <tr>\n");
+        if ((keep && !keep[m->idx]) || (opt->cluster && cl.of[m->idx] >= 0)) { m = m->next; continue; }
+        write_dot_module(f, m);
 
-        // --- 1. LEFT COLUMN: INPUTS ---
-        fprintf(f, "      <td>\n"); 
-        
-        bool has_in = false;
-        Port* p = m->ports;
-        while(p) { if(p->dir == DIR_IN) has_in = true; p = p->next; }
-
-        if (has_in) {
-            // Inner table: Handles the border and white background
-            fprintf(f, "        <table border=\"0\" cellborder=\"1\" cellspacing=\"0\" cellpadding=\"4\" bgcolor=\"#ffffff\">\n");
-            p = m->ports;
-            while(p) {
-                if(p->dir == DIR_IN) {
-                    fprintf(f, "          <tr><td port=\"%s\">%s</td></tr>\n", p->name, p->name);
-                }
-                p = p->next;
+        m = m->next;
+    }
+
+    // Clustered modules go inside their subgraph
+    for (int c = 0; opt->cluster && c < cl.n; c++) {
+        bool opened = false;
+        for (int k = cl.member_off[c]; k < cl.member_off[c + 1]; k++) {
+            Module* cm = cl.members[k];
+            if (keep && !keep[cm->idx]) continue;
+            if (!opened) {
+                fprintf(f, "  subgraph cluster_%d {\n    label=", c);
+                dot_quoted(f, cl.names[c]);
+                fprintf(f, ";\n    style=rounded;\n\n");
+                opened = true;
             }
-            fprintf(f, "        </table>\n");
+            write_dot_module(f, cm);
         }
-        fprintf(f, "      </td>\n");
+        if (opened) fprintf(f, "  }\n\n");
+    }
+    if (opt->cluster) clusters_free(&cl);
 
-        // --- 2. MIDDLE COLUMN: MODULE NAME ---
-        // FIX: Moved border/bgcolor from <TD> to the <TABLE>. 
-        // This fixes the "mismatched tag" error on older/strict parsers.
-        fprintf(f, "      <td>\n");
-        fprintf(f, "        <table border=\"1\" cellborder=\"0\" cellspacing=\"0\" cellpadding=\"8\" bgcolor=\"#f0f0f0\">\n");
-        fprintf(f, "          <tr><td><b>%s</b></td></tr>\n", m->name);
-        fprintf(f, "        </table>\n");
-        fprintf(f, "      </td>\n");
+    fprintf(f, "\n");
+    
+    // --- Define Edges ---
+    if (opt->aggregate) write_dot_aggregated(f, keep);
+    else for (m = root_modules; m; m = m->next) {
+        if (keep && !keep[m->idx]) continue;
+        for (Port* p = m->ports; p; p = p->next) {
+            if (p->dir != DIR_OUT || p->dest_module[0] == '\0') continue;
+            if (keep) {
+                Module* dm = get_module(p->dest_module, false);
+                if (!dm || !keep[dm->idx]) continue;
+            }
+            // Removed :e/:w constraints to allow polyline splines to route cleanly
+            fprintf(f, "  %s:%s -> %s:%s;\n", m->name, p->name, p->dest_module, p->dest_port);
+        }
+    }
 
-        // --- 3. RIGHT COLUMN: OUTPUTS ---
-        fprintf(f, "      <td>\n");
-        
-        bool has_out = false;
-        p = m->ports;
-        while(p) { if(p->dir == DIR_OUT) has_out = true; p = p->next; }
-
-        if (has_out) {
-            // Inner table: Handles the border and white background
-            fprintf(f, "        <table border=\"0\" cellborder=\"1\" cellspacing=\"0\" cellpadding=\"4\" bgcolor=\"#ffffff\">\n");
-            p = m->ports;
-            while(p) {
-                if(p->dir == DIR_OUT) {
-                    fprintf(f, "          <tr><td port=\"%s\">%s</td></tr>\n", p->name, p->name);
+    fprintf(f, "}\n");
+    fclose(f);
+    return dot_text;
+}
+
+void cmd_dot(int argc, char* argv[]) {
+    DotOptions opt;
+    if (!parse_dot_options(argc, argv, &opt)) return;
+
+    char formats[MAX_FORMATS][MAX_STR];
+    int n_formats = parse_formats(opt.formats, formats);
+    if (n_formats == 0) { printf("Error: No valid output formats in '%s'.\n", opt.formats); return; }
+
+    // Neighbourhood view: keep[Module::idx] marks what gets rendered
+    bool* keep = NULL;
+    if (opt.focus) {
+        Module* center = get_module(opt.focus, false);
+        if (!center) { printf("Error: Module '%s' not found.\n", opt.focus); return; }
+        Graph* full = graph_build(NULL);
+        bool* seen = graph_neighbourhood(full, full->node_of[center->idx], opt.depth, opt.up, opt.down);
+        keep = (bool*)xcalloc(module_count, sizeof(bool));
+        for (int i = 0; i < full->n; i++) keep[full->mods[i]->idx] = seen[i];
+        free(seen);
+        graph_free(full);
+    }
+
+    if (strcmp(opt.engine, "native") == 0) {
+        // Built-in layout: writes SVG straight from memory, no Graphviz
+        for (int i = 0; opt.formats_given && i < n_formats; i++)
+            if (strcmp(formats[i], "svg") != 0)
+                printf("Note: The native engine writes SVG only; skipping %s.\n", formats[i]);
+        if (opt.cluster || opt.aggregate) printf("Note: --cluster and --aggregate apply to the Graphviz engine only.\n");
+        Graph* g = graph_build(keep);
+        int reused = 0;
+        Layout* lay = layout_run(g, opt.fresh, &reused);
+        TraceSpan span = trace_begin("native_write_svg", "serialize");
+        bool ok = native_write_svg(g, lay, "graph.svg");
+        if (ok) layout_save(lay, g, LAYOUT_FILE);
+        trace_end(span);
+        if (reused > 0) printf("Kept the positions of %d of %d modules.\n", reused, g->n);
+        layout_free(lay);
+        graph_free(g);
+        free(keep);
+        if (ok) printf("Generated graph.svg successfully.\n");
+        else printf("Error: Could not write graph.svg.\n");
+        return;
+    }
+
+    // Build the DOT text in memory first; its hash is the cache key
+    size_t dot_len = 0;
+    TraceSpan span = trace_begin("build_dot_text", "serialize");
+    char* dot_text = build_dot_text(&opt, keep, &dot_len);
+    trace_end(span);
+    free(keep);
+    if (!dot_text) return;
+    render_dot_text(dot_text, dot_len, formats, n_formats, opt.use_cache);
+}
+
+// --- Design Structure Matrix ---
+
+// Row r, column c is set when module r reads from module c, so with
+// providers ordered before their consumers every link sits below the
+// diagonal and the entries above it are feedback. Rows are packed
+// bitsets over the display order.
+
+#define DSM_MAX_CELLS 1000  // SVG heatmap is binned down to this many cells a side
+#define DSM_MAX_MODULES 32768 // The dense bitset is n*n bits: 128 MB at this size
+
+typedef struct {
+    int n;
+    Graph* g;
+    int* order;             // Display position -> graph node
+    int* pos;               // Graph node -> display position
+    size_t words;           // 64-bit words per row
+    uint64_t* bits;         // Row r starts at bits[r * words]
+    long links;             // Set cells
+    long above;             // Set cells above the diagonal
+} Dsm;
+
+typedef struct {
+    Dsm* d;
+    long* above;            // Per row
+    long* links;
+} DsmFillCtx;
+
+bool dsm_get(Dsm* d, int r, int c) {
+    return (d->bits[(size_t)r * d->words + (c >> 6)] >> (c & 63)) & 1;
+}
+
+// Rows are independent, so they are filled in parallel from the pred lists
+void dsm_fill_range(void* arg, int begin, int end) {
+    DsmFillCtx* ctx = (DsmFillCtx*)arg;
+    Dsm* d = ctx->d;
+    for (int r = begin; r < end; r++) {
+        int u = d->order[r];
+        uint64_t* row = d->bits + (size_t)r * d->words;
+        for (int e = d->g->pred_off[u]; e < d->g->pred_off[u + 1]; e++) {
+            int c = d->pos[d->g->pred[e]];
+            if (c != r) row[c >> 6] |= 1ULL << (c & 63);
+        }
+        long links = 0, above = 0;
+        for (size_t w = 0; w < d->words; w++) links += __builtin_popcountll(row[w]);
+        size_t first = (size_t)(r + 1) >> 6;
+        for (size_t w = first; w < d->words; w++) {
+            uint64_t word = row[w];
+            if (w == first) word &= ~0ULL << ((r + 1) & 63);
+            above += __builtin_popcountll(word);
+        }
+        ctx->links[r] = links;
+        ctx->above[r] = above;
+    }
+}
+
+// Distinct module pairs sorted by source, as feedback_order() expects
+Pair* dsm_pairs(Graph* g, int* np_out, int** off_out) {
+    Pair* pairs = (Pair*)xcalloc(g->n_edges, sizeof(Pair));
+    int np = 0;
+    for (int u = 0; u < g->n; u++)
+        for (int e = g->succ_off[u]; e < g->succ_off[u + 1]; e++)
+            if (g->succ[e] != u) pairs[np++] = (Pair){ u, g->succ[e] };
+    qsort(pairs, np, sizeof(Pair), pair_cmp);
+    int uniq = 0;
+    for (int i = 0; i < np; i++)
+        if (uniq == 0 || pair_cmp(&pairs[uniq - 1], &pairs[i]) != 0) pairs[uniq++] = pairs[i];
+    int* off = (int*)xcalloc(g->n + 1, sizeof(int));
+    for (int i = 0; i < uniq; i++) off[pairs[i].from + 1]++;
+    for (int i = 0; i < g->n; i++) off[i + 1] += off[i];
+    *np_out = uniq;
+    *off_out = off;
+    return pairs;
+}
+
+// Sort keys for the cluster order: cluster rank first, then module rank
+static int* dsm_key_major;
+static int* dsm_key_minor;
+
+int dsm_key_cmp(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    if (dsm_key_major[x] != dsm_key_major[y]) return dsm_key_major[x] < dsm_key_major[y] ? -1 : 1;
+    return dsm_key_minor[x] - dsm_key_minor[y];
+}
+
+// Orders the nodes: "list" keeps the model order, "topo" is a greedy
+// feedback-arc ordering over modules, "cluster" keeps each cluster
+// contiguous and orders clusters, then modules inside them, the same way
+bool dsm_order(Dsm* d, const char* order, const char* cluster_mode) {
+    Graph* g = d->g;
+    for (int i = 0; i < g->n; i++) d->order[i] = i;
+    if (strcmp(order, "list") == 0) return true;
+    if (strcmp(order, "topo") != 0 && strcmp(order, "cluster") != 0) {
+        printf("Error: Unknown order '%s' (expected topo, cluster or list).\n", order);
+        return false;
+    }
+
+    int np;
+    int* off;
+    Pair* pairs = dsm_pairs(g, &np, &off);
+    int* rank = feedback_order(g->n, np, pairs, off);
+    int* major = (int*)xcalloc(g->n, sizeof(int));
+
+    if (strcmp(order, "cluster") == 0) {
+        Clusters cl;
+        if (!clusters_build(cluster_mode, &cl)) {
+            free(pairs); free(off); free(rank); free(major);
+            return false;
+        }
+        // Unclustered modules count as clusters of their own
+        int n_groups = cl.n + g->n;
+        int* group = (int*)xcalloc(g->n, sizeof(int));
+        for (int i = 0; i < g->n; i++) {
+            int c = cl.of[g->mods[i]->idx];
+            group[i] = c >= 0 ? c : cl.n + i;
+        }
+        Pair* gp = (Pair*)xcalloc(np ? np : 1, sizeof(Pair));
+        int ngp = 0;
+        for (int i = 0; i < np; i++) {
+            int a = group[pairs[i].from], b = group[pairs[i].to];
+            if (a != b) gp[ngp++] = (Pair){ a, b };
+        }
+        qsort(gp, ngp, sizeof(Pair), pair_cmp);
+        int uniq = 0;
+        for (int i = 0; i < ngp; i++)
+            if (uniq == 0 || pair_cmp(&gp[uniq - 1], &gp[i]) != 0) gp[uniq++] = gp[i];
+        int* goff = (int*)xcalloc(n_groups + 1, sizeof(int));
+        for (int i = 0; i < uniq; i++) goff[gp[i].from + 1]++;
+        for (int i = 0; i < n_groups; i++) goff[i + 1] += goff[i];
+        int* grank = feedback_order(n_groups, uniq, gp, goff);
+        for (int i = 0; i < g->n; i++) major[i] = grank[group[i]];
+        free(grank); free(goff); free(gp); free(group);
+        clusters_free(&cl);
+    }
+
+    dsm_key_major = major;
+    dsm_key_minor = rank;
+    qsort(d->order, g->n, sizeof(int), dsm_key_cmp);
+    free(major); free(rank); free(pairs); free(off);
+    return true;
+}
+
+Dsm* dsm_build(const char* order, const char* cluster_mode) {
+    if (module_count > DSM_MAX_MODULES) {
+        printf("Error: The DSM of %d modules would need %.1f GB; the limit is %d modules.\n",
+               module_count, (double)module_count * module_count / 8 / 1e9, DSM_MAX_MODULES);
+        return NULL;
+    }
+    Dsm* d = (Dsm*)xcalloc(1, sizeof(Dsm));
+    d->g = graph_build(NULL);
+    d->n = d->g->n;
+    d->order = (int*)xcalloc(d->n, sizeof(int));
+    d->pos = (int*)xcalloc(d->n, sizeof(int));
+    if (!dsm_order(d, order, cluster_mode)) {
+        graph_free(d->g);
+        free(d->order); free(d->pos); free(d);
+        return NULL;
+    }
+    for (int r = 0; r < d->n; r++) d->pos[d->order[r]] = r;
+
+    d->words = ((size_t)d->n + 63) / 64;
+    d->bits = (uint64_t*)xcalloc((size_t)d->n * d->words, sizeof(uint64_t));
+    DsmFillCtx ctx = { d, (long*)xcalloc(d->n, sizeof(long)), (long*)xcalloc(d->n, sizeof(long)) };
+    pool_parallel_for(d->n, 256, dsm_fill_range, &ctx);
+    for (int r = 0; r < d->n; r++) {
+        d->links += ctx.links[r];
+        d->above += ctx.above[r];
+    }
+    free(ctx.above);
+    free(ctx.links);
+    return d;
+}
+
+void dsm_free(Dsm* d) {
+    graph_free(d->g);
+    free(d->order);
+    free(d->pos);
+    free(d->bits);
+    free(d);
+}
+
+void dsm_write_text(FILE* f, Dsm* d) {
+    int name_w = 4;
+    for (int r = 0; r < d->n; r++) {
+        int len = (int)strlen(d->g->mods[d->order[r]]->name);
+        if (len > name_w) name_w = len;
+    }
+    char* line = (char*)xcalloc(d->n + 2, 1);
+    for (int r = 0; r < d->n; r++) {
+        for (int c = 0; c < d->n; c++)
+            line[c] = c == r ? '\\' : dsm_get(d, r, c) ? (c > r ? '!' : 'x') : '.';
+        line[d->n] = '\n';
+        fprintf(f, "%5d %-*s ", r + 1, name_w, d->g->mods[d->order[r]]->name);
+        fputs(line, f);
+    }
+    free(line);
+}
+
+// One CSV field, quoted per RFC 4180 when it holds a separator, quote or newline
+void csv_field(FILE* f, const char* s) {
+    if (!strpbrk(s, ",\"\r\n")) { fputs(s, f); return; }
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+void dsm_write_csv(FILE* f, Dsm* d) {
+    for (int c = 0; c < d->n; c++) {
+        fputc(',', f);
+        csv_field(f, d->g->mods[d->order[c]]->name);
+    }
+    fputc('\n', f);
+    char* line = (char*)xcalloc(2 * (size_t)d->n + 2, 1);
+    for (int r = 0; r < d->n; r++) {
+        for (int c = 0; c < d->n; c++) {
+            line[2 * c] = ',';
+            line[2 * c + 1] = dsm_get(d, r, c) ? '1' : '0';
+        }
+        line[2 * d->n] = '\n';
+        csv_field(f, d->g->mods[d->order[r]]->name);
+        fputs(line, f);
+    }
+    free(line);
+}
+
+// Heatmap: big matrices are binned so the file stays small, and each
+// cell is shaded by how many links fall into it. Feedback is red.
+bool dsm_write_svg(Dsm* d, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    int bin = (d->n + DSM_MAX_CELLS - 1) / DSM_MAX_CELLS;
+    if (bin < 1) bin = 1;
+    int cells = (d->n + bin - 1) / bin;
+    double cell = cells > 200 ? 1 : cells > 50 ? 6 : 14;
+    double label_w = bin == 1 && cells <= 200 ? CHAR_W * 20 : 0;
+    double size = label_w + cells * cell + 2 * MARGIN;
+
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.0f\" height=\"%.0f\" viewBox=\"0 0 %.0f %.0f\" shape-rendering=\"crispEdges\">\n",
+            size, size, size, size);
+    fprintf(f, "<style>text{font-family:Arial;font-size:%.0fpx;text-anchor:end}"
+               ".b{fill:#1f4e9e}.f{fill:#d62728}.d{fill:#c0c0c0}</style>\n", cell > 12 ? 11.0 : 5.0);
+    fprintf(f, "<rect width=\"100%%\" height=\"100%%\" fill=\"#ffffff\"/>\n");
+    double x0 = MARGIN + label_w, y0 = MARGIN + label_w;
+    fprintf(f, "<rect x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%.1f\" fill=\"none\" stroke=\"#808080\"/>\n",
+            x0, y0, cells * cell, cells * cell);
+
+    if (label_w > 0) {
+        for (int r = 0; r < d->n; r++) {
+            const char* name = d->g->mods[d->order[r]]->name;
+            fprintf(f, "<text x=\"%.1f\" y=\"%.1f\">", x0 - 3, y0 + r * cell + cell - 3);
+            svg_text(f, name);
+            fprintf(f, "</text>\n<text transform=\"translate(%.1f,%.1f) rotate(90)\">",
+                    x0 + r * cell + cell - 3, y0 - 3);
+            svg_text(f, name);
+            fprintf(f, "</text>\n");
+        }
+    }
+
+    int* counts = (int*)xcalloc(cells, sizeof(int));
+    for (int br = 0; br < cells; br++) {
+        memset(counts, 0, cells * sizeof(int));
+        int r_end = (br + 1) * bin < d->n ? (br + 1) * bin : d->n;
+        for (int r = br * bin; r < r_end; r++) {
+            uint64_t* row = d->bits + (size_t)r * d->words;
+            for (size_t w = 0; w < d->words; w++)
+                for (uint64_t word = row[w]; word; word &= word - 1)
+                    counts[((int)(w * 64) + __builtin_ctzll(word)) / bin]++;
+        }
+        fprintf(f, "<rect class=\"d\" x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%.1f\"/>\n",
+                x0 + br * cell, y0 + br * cell, cell, cell);
+        for (int bc = 0; bc < cells; bc++) {
+            if (counts[bc] == 0) continue;
+            double fill = (double)counts[bc] / ((double)bin * bin);
+            double opacity = bin == 1 ? 1 : 0.35 + 0.65 * (fill > 0.05 ? 1 : fill / 0.05);
+            fprintf(f, "<rect class=\"%c\" x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%.1f\"",
+                    bc > br ? 'f' : 'b', x0 + bc * cell, y0 + br * cell, cell, cell);
+            if (opacity < 1) fprintf(f, " fill-opacity=\"%.2f\"", opacity);
+            fprintf(f, "/>\n");
+        }
+    }
+    free(counts);
+    fprintf(f, "</svg>\n");
+    return fclose_counted(f) == 0;
+}
+
+void cmd_dsm(int argc, char* argv[]) {
+    const char* order = "list";
+    const char* format = "text";
+    const char* cluster = "prefix";
+    const char* output = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--order") == 0 && i + 1 < argc) order = argv[++i];
+        else if (strncmp(argv[i], "--order=", 8) == 0) order = argv[i] + 8;
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) format = argv[++i];
+        else if (strncmp(argv[i], "--format=", 9) == 0) format = argv[i] + 9;
+        else if (strcmp(argv[i], "--cluster") == 0 && i + 1 < argc) cluster = argv[++i];
+        else if (strncmp(argv[i], "--cluster=", 10) == 0) cluster = argv[i] + 10;
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+        else { printf("Error: Unknown option for 'dsm': %s\n", argv[i]); return; }
+    }
+    bool svg = strcmp(format, "svg") == 0;
+    if (!svg && strcmp(format, "text") != 0 && strcmp(format, "csv") != 0) {
+        printf("Error: Unknown format '%s' (expected text, csv or svg).\n", format);
+        return;
+    }
+    if (svg && !output) output = "dsm.svg";
+
+    TraceSpan span = trace_begin("dsm_build", "index");
+    Dsm* d = dsm_build(order, cluster);
+    trace_end(span);
+    if (!d) return;
+
+    span = trace_begin("dsm write", "serialize");
+    bool ok = true;
+    if (svg) {
+        ok = dsm_write_svg(d, output);
+    } else {
+        FILE* f = output ? fopen(output, "w") : stdout;
+        if (!f) ok = false;
+        else {
+            if (format[0] == 'c') dsm_write_csv(f, d);
+            else dsm_write_text(f, d);
+            if (output) ok = fclose_counted(f) == 0;
+        }
+    }
+    trace_end(span);
+
+    if (!ok) printf("Error: Could not write '%s'.\n", output);
+    else if (output || !strcmp(format, "text"))
+        printf("%sDSM: %d modules, %ld dependencies, %ld above the diagonal.\n",
+               output ? "" : "\n", d->n, d->links, d->above);
+    if (ok && output) printf("Generated %s successfully.\n", output);
+    dsm_free(d);
+}
+
+// --- HTML Export ---
+
+// A single self-contained page for graphs too big for one SVG. Module
+// boxes are always loaded and cached as an overview bitmap; ports and
+// links are split into square tiles, each kept as an unparsed JSON block
+// until it first scrolls into view. Zoomed out the page shows boxes only,
+// zoomed in it adds links, names and finally ports.
+
+#define TILE_SIZE 1024.0
+
+// Writes a JSON string that is also safe inside <script>
+void json_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') { fputc('\\', f); fputc(*s, f); }
+        else if (*s == '<') fputs("\\u003c", f);
+        else if ((unsigned char)*s < 0x20) fprintf(f, "\\u%04x", *s);
+        else fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// Growable per-tile text buffers
+typedef struct {
+    char* text;
+    size_t len;
+    FILE* f;
+} TileBuf;
+
+FILE* tile_stream(TileBuf* tiles, int t) {
+    if (!tiles[t].f) {
+        tiles[t].f = open_memstream(&tiles[t].text, &tiles[t].len);
+        if (!tiles[t].f) { printf("Memory allocation failed\n"); exit(1); }
+    }
+    return tiles[t].f;
+}
+
+static const char* html_viewer_js =
+    "const cv=document.getElementById('c'),cx=cv.getContext('2d'),info=document.getElementById('info');\n"
+    "const N=M.name.length,COLS=LCOLS[0],ROWS=LROWS[0];\n"
+    "const LOD_BOX=0.12,LOD_PORT=0.6;\n"
+    "let scale=1,ox=0,oy=0,frame=0,queued=false;\n"
+    "// Modules per tile, from the always-loaded boxes\n"
+    "const grid=new Map();\n"
+    "for(let i=0;i<N;i++){const b=M.box;\n"
+    "  const x0=Math.floor(b[4*i]/TILE),x1=Math.min(COLS-1,Math.floor((b[4*i]+b[4*i+2])/TILE));\n"
+    "  const y0=Math.floor(b[4*i+1]/TILE),y1=Math.min(ROWS-1,Math.floor((b[4*i+1]+b[4*i+3])/TILE));\n"
+    "  for(let ty=y0;ty<=y1;ty++)for(let tx=x0;tx<=x1;tx++){const k=ty*COLS+tx;\n"
+    "    if(!grid.has(k))grid.set(k,[]);grid.get(k).push(i);}}\n"
+    "// Tiles are parsed on first use and the least recently used dropped\n"
+    "const parsed=new Map(),MAX_PARSED=1024;\n"
+    "function tile(l,k){const id='t'+l+'_'+k;let t=parsed.get(id);\n"
+    "  if(t){parsed.delete(id);parsed.set(id,t);return t;}\n"
+    "  const el=document.getElementById(id);t=el?JSON.parse(el.textContent):{e:[],p:[]};\n"
+    "  t.ports=new Map();for(const p of t.p)t.ports.set(p[0],p);\n"
+    "  parsed.set(id,t);if(parsed.size>MAX_PARSED)parsed.delete(parsed.keys().next().value);return t;}\n"
+    "// Overview bitmap of every box, drawn once\n"
+    "const os=Math.min(1,4096/Math.max(W,H)),ov=document.createElement('canvas');\n"
+    "ov.width=Math.max(1,Math.ceil(W*os));ov.height=Math.max(1,Math.ceil(H*os));\n"
+    "{const o=ov.getContext('2d');o.fillStyle='#ffffff';o.fillRect(0,0,ov.width,ov.height);o.fillStyle='#5a6f8f';\n"
+    "  for(let i=0;i<N;i++){const b=M.box;o.fillRect(b[4*i]*os,b[4*i+1]*os,Math.max(1,b[4*i+2]*os),Math.max(1,b[4*i+3]*os));}}\n"
+    "function resize(){cv.width=innerWidth;cv.height=innerHeight;redraw();}\n"
+    "function fit(){scale=Math.min(cv.width/W,cv.height/H);ox=0;oy=0;redraw();}\n"
+    "function redraw(){if(!queued){queued=true;requestAnimationFrame(draw);}}\n"
+    "const seen=new Int32Array(N);\n"
+    "function draw(){queued=false;frame++;\n"
+    "  cx.setTransform(1,0,0,1,0,0);cx.fillStyle='#ffffff';cx.fillRect(0,0,cv.width,cv.height);\n"
+    "  if(scale<LOD_BOX){cx.imageSmoothingEnabled=true;cx.drawImage(ov,-ox*scale,-oy*scale,W*scale,H*scale);\n"
+    "    info.textContent=N+' modules - zoom in for links and ports';return;}\n"
+    "  const tx0=Math.max(0,Math.floor(ox/TILE)),tx1=Math.min(COLS-1,Math.floor((ox+cv.width/scale)/TILE));\n"
+    "  const ty0=Math.max(0,Math.floor(oy/TILE)),ty1=Math.min(ROWS-1,Math.floor((oy+cv.height/scale)/TILE));\n"
+    "  cx.setTransform(scale,0,0,scale,-ox*scale,-oy*scale);\n"
+    "  cx.lineWidth=1/Math.min(scale,1);cx.strokeStyle='#000000';cx.beginPath();\n"
+    "  for(let l=0;l<LEVELS;l++){const S=TILE*2**l,cols=LCOLS[l],rows=LROWS[l];\n"
+    "    const x0=Math.max(0,Math.floor((ox-S/2)/S)),x1=Math.min(cols-1,Math.floor((ox+cv.width/scale+S/2)/S));\n"
+    "    const y0=Math.max(0,Math.floor((oy-S/2)/S)),y1=Math.min(rows-1,Math.floor((oy+cv.height/scale+S/2)/S));\n"
+    "    for(let ty=y0;ty<=y1;ty++)for(let tx=x0;tx<=x1;tx++){const e=tile(l,ty*cols+tx).e;\n"
+    "      for(let j=0;j<e.length;j+=4){cx.moveTo(e[j],e[j+1]);cx.lineTo(e[j+2],e[j+3]);}}}\n"
+    "  cx.stroke();\n"
+    "  const names=scale*12>=6,ports=scale>=LOD_PORT;let shown=0;\n"
+    "  cx.font='12px Arial';cx.textAlign='center';cx.textBaseline='middle';\n"
+    "  for(let ty=ty0;ty<=ty1;ty++)for(let tx=tx0;tx<=tx1;tx++){const k=ty*COLS+tx,ids=grid.get(k);if(!ids)continue;\n"
+    "    const t=ports?tile(0,k):null;\n"
+    "    for(const i of ids){if(seen[i]===frame)continue;seen[i]=frame;shown++;\n"
+    "      const b=M.box,x=b[4*i],y=b[4*i+1],w=b[4*i+2],h=b[4*i+3],p=t&&t.ports.get(i);\n"
+    "      if(!p){cx.fillStyle='#f0f0f0';cx.fillRect(x,y,w,h);cx.strokeRect(x,y,w,h);\n"
+    "        if(names){cx.fillStyle='#000000';cx.fillText(M.name[i],x+w/2,y+h/2);}continue;}\n"
+    "      const iw=p[1],ow=p[2],nw=w-iw-ow;\n"
+    "      cell(x,y,h,iw,p[3]);cell(x+iw+nw,y,h,ow,p[4]);\n"
+    "      const ny=y+(h-NAME_H)/2;cx.fillStyle='#f0f0f0';cx.fillRect(x+iw,ny,nw,NAME_H);cx.strokeRect(x+iw,ny,nw,NAME_H);\n"
+    "      cx.fillStyle='#000000';cx.font='bold 12px Arial';cx.fillText(M.name[i],x+iw+nw/2,ny+NAME_H/2);cx.font='12px Arial';}}\n"
+    "  info.textContent=shown+' of '+N+' modules in view';}\n"
+    "function cell(x,y,h,w,names){const top=y+(h-names.length*ROW_H)/2;\n"
+    "  for(let k=0;k<names.length;k++){const cy=top+k*ROW_H;\n"
+    "    cx.fillStyle='#ffffff';cx.fillRect(x,cy,w,ROW_H);cx.strokeRect(x,cy,w,ROW_H);\n"
+    "    cx.fillStyle='#000000';cx.fillText(names[k],x+w/2,cy+ROW_H/2);}}\n"
+    "let drag=null;\n"
+    "cv.addEventListener('mousedown',e=>{drag={x:e.clientX,y:e.clientY};});\n"
+    "addEventListener('mouseup',()=>{drag=null;});\n"
+    "addEventListener('mousemove',e=>{if(!drag)return;ox-=(e.clientX-drag.x)/scale;oy-=(e.clientY-drag.y)/scale;\n"
+    "  drag={x:e.clientX,y:e.clientY};redraw();});\n"
+    "cv.addEventListener('wheel',e=>{e.preventDefault();const f=Math.exp(-e.deltaY*0.0015);\n"
+    "  const wx=ox+e.clientX/scale,wy=oy+e.clientY/scale;scale=Math.min(8,Math.max(1e-4,scale*f));\n"
+    "  ox=wx-e.clientX/scale;oy=wy-e.clientY/scale;redraw();},{passive:false});\n"
+    "document.getElementById('q').addEventListener('keydown',e=>{if(e.key!=='Enter')return;\n"
+    "  const i=M.name.indexOf(e.target.value);if(i<0){info.textContent='No module '+e.target.value;return;}\n"
+    "  const b=M.box;scale=1;ox=b[4*i]+b[4*i+2]/2-cv.width/2;oy=b[4*i+1]+b[4*i+3]/2-cv.height/2;redraw();});\n"
+    "addEventListener('resize',resize);resize();fit();\n";
+
+bool write_html(Graph* g, Layout* lay, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    int cols = (int)(lay->width / TILE_SIZE) + 1;
+    int rows = (int)(lay->height / TILE_SIZE) + 1;
+    TileBuf* tiles = (TileBuf*)xcalloc((size_t)cols * rows, sizeof(TileBuf));
+
+    // Ports of each module go to every tile its box touches
+    for (int u = 0; u < g->n; u++) {
+        ModuleShape s;
+        module_shape(g->mods[u], &s);
+        int tx0 = (int)(lay->x[u] / TILE_SIZE), tx1 = (int)((lay->x[u] + lay->w[u]) / TILE_SIZE);
+        int ty0 = (int)(lay->y[u] / TILE_SIZE), ty1 = (int)((lay->y[u] + lay->h[u]) / TILE_SIZE);
+        for (int ty = ty0; ty <= ty1 && ty < rows; ty++) {
+            for (int tx = tx0; tx <= tx1 && tx < cols; tx++) {
+                FILE* t = tile_stream(tiles, ty * cols + tx);
+                fprintf(t, "%s[%d,%.0f,%.0f,[", ftell(t) ? "," : "", u, s.in_w, s.out_w);
+                for (int pass = 0; pass < 2; pass++) {
+                    bool first = true;
+                    for (Port* p = g->mods[u]->ports; p; p = p->next) {
+                        if (p->dir != (pass == 0 ? DIR_IN : DIR_OUT)) continue;
+                        if (!first) fputc(',', t);
+                        json_string(t, p->name);
+                        first = false;
+                    }
+                    fputs(pass == 0 ? "],[" : "]]", t);
                 }
-                p = p->next;
             }
-            fprintf(f, "        </table>\n");
         }
-        fprintf(f, "      </td>\n");
+    }
 
-        fprintf(f, "    </tr>\n");
-        fprintf(f, "   </table>>];\n\n");
+    // Links form a loose quadtree: each segment is stored once, in the
+    // smallest level whose tiles are at least as big as the segment, in
+    // the tile under its midpoint. The viewer widens its view by half a
+    // tile per level, so every segment it may need is loaded.
+    int levels = 1;
+    while (TILE_SIZE * (1 << (levels - 1)) < (lay->width > lay->height ? lay->width : lay->height)) levels++;
+    TileBuf** edges = (TileBuf**)xcalloc(levels, sizeof(TileBuf*));
+    int* level_cols = (int*)xcalloc(levels, sizeof(int));
+    int* level_rows = (int*)xcalloc(levels, sizeof(int));
+    for (int l = 0; l < levels; l++) {
+        double size = TILE_SIZE * (1 << l);
+        level_cols[l] = (int)(lay->width / size) + 1;
+        level_rows[l] = (int)(lay->height / size) + 1;
+        edges[l] = (TileBuf*)xcalloc((size_t)level_cols[l] * level_rows[l], sizeof(TileBuf));
+    }
+    double pts[2 * EDGE_MAX_POINTS];
+    for (int u = 0; u < g->n; u++) {
+        ModuleShape su;
+        module_shape(g->mods[u], &su);
+        int out_k = 0;
+        for (Port* p = g->mods[u]->ports; p; p = p->next) {
+            if (p->dir != DIR_OUT) continue;
+            int v, k = out_k++;
+            int n = edge_route(g, lay, u, su.n_out, k, p, pts, &v);
+            for (int j = 0; j + 1 < n; j++) {
+                double x1 = pts[2 * j], y1 = pts[2 * j + 1], x2 = pts[2 * j + 2], y2 = pts[2 * j + 3];
+                double span = x2 - x1 < 0 ? x1 - x2 : x2 - x1;
+                if (y2 - y1 > span) span = y2 - y1;
+                if (y1 - y2 > span) span = y1 - y2;
+                int l = 0;
+                while (l < levels - 1 && TILE_SIZE * (1 << l) < span) l++;
+                double size = TILE_SIZE * (1 << l);
+                int tx = (int)((x1 + x2) / 2 / size), ty = (int)((y1 + y2) / 2 / size);
+                if (tx < 0) tx = 0;
+                if (ty < 0) ty = 0;
+                if (tx >= level_cols[l]) tx = level_cols[l] - 1;
+                if (ty >= level_rows[l]) ty = level_rows[l] - 1;
+                FILE* t = tile_stream(edges[l], ty * level_cols[l] + tx);
+                fprintf(t, "%s%.0f,%.0f,%.0f,%.0f", ftell(t) ? "," : "", x1, y1, x2, y2);
+            }
+        }
+    }
 
-        m = m->next;
+    fprintf(f, "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>links</title>\n");
+    fprintf(f, "<style>html,body{margin:0;height:100%%;overflow:hidden;font-family:Arial}"
+               "canvas{display:block;cursor:grab}"
+               "#bar{position:fixed;top:8px;left:8px;background:#ffffffe0;padding:4px 8px;border:1px solid #c0c0c0}"
+               "#info{margin-left:8px;font-size:12px}</style></head>\n");
+    fprintf(f, "<body><div id=\"bar\"><input id=\"q\" placeholder=\"Find module\"><span id=\"info\"></span></div>"
+               "<canvas id=\"c\"></canvas>\n");
+    fprintf(f, "<script>\nconst W=%.0f,H=%.0f,TILE=%.0f,LEVELS=%d,ROW_H=%.0f,NAME_H=%.0f;\n",
+            lay->width, lay->height, TILE_SIZE, levels, ROW_H, NAME_H);
+    // Tile grid sizes as computed here: W and H are rounded, so the
+    // viewer must not derive them again or tile ids would not line up
+    for (int pass = 0; pass < 2; pass++) {
+        fputs(pass == 0 ? "const LCOLS=[" : "],LROWS=[", f);
+        for (int l = 0; l < levels; l++)
+            fprintf(f, "%s%d", l ? "," : "", pass == 0 ? level_cols[l] : level_rows[l]);
     }
+    fputs("];\n", f);
+    fprintf(f, "const M={name:[");
+    for (int u = 0; u < g->n; u++) {
+        if (u) fputc(',', f);
+        json_string(f, g->mods[u]->name);
+    }
+    fprintf(f, "],\nbox:[");
+    for (int u = 0; u < g->n; u++)
+        fprintf(f, "%s%.0f,%.0f,%.0f,%.0f", u ? "," : "", lay->x[u], lay->y[u], lay->w[u], lay->h[u]);
+    fprintf(f, "]};\n</script>\n");
 
-    fprintf(f, "\n");
-    
-    // --- Define Edges ---
-    m = root_modules;
-    while (m) {
-        Port* p = m->ports;
-        while (p) {
-            if (p->dir == DIR_OUT && strlen(p->dest_module) > 0) {
-                // Removed :e/:w constraints to allow polyline splines to route cleanly
-                fprintf(f, "  %s:%s -> %s:%s;\n", 
-                        m->name, p->name, p->dest_module, p->dest_port);
+    // Tiles stay as text until the viewer asks for them
+    for (int l = 0; l < levels; l++) {
+        for (int t = 0; t < level_cols[l] * level_rows[l]; t++) {
+            TileBuf* ports = l == 0 ? &tiles[t] : NULL;
+            TileBuf* links = &edges[l][t];
+            if (!links->f && !(ports && ports->f)) continue;
+            if (ports && ports->f) fclose(ports->f);
+            if (links->f) fclose(links->f);
+            fprintf(f, "<script type=\"application/json\" id=\"t%d_%d\">{\"p\":[", l, t);
+            if (ports && ports->text) fwrite(ports->text, 1, ports->len, f);
+            fprintf(f, "],\"e\":[");
+            if (links->text) fwrite(links->text, 1, links->len, f);
+            fprintf(f, "]}</script>\n");
+            if (ports) free(ports->text);
+            free(links->text);
+        }
+        free(edges[l]);
+    }
+    free(tiles);
+    free(edges);
+    free(level_cols);
+    free(level_rows);
+
+    fprintf(f, "<script>\n%s</script>\n</body></html>\n", html_viewer_js);
+    return fclose_counted(f) == 0;
+}
+
+void cmd_export(int argc, char* argv[]) {
+    const char* output = "graph.html";
+    bool html = false, fresh = false;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--html") == 0) html = true;
+        else if (strcmp(argv[i], "--fresh") == 0) fresh = true;
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+        else { printf("Error: Unknown option for 'export': %s\n", argv[i]); return; }
+    }
+    if (!html) { printf("Usage: links export --html [-o file] [--fresh]\n"); return; }
+
+    Graph* g = graph_build(NULL);
+    int reused = 0;
+    Layout* lay = layout_run(g, fresh, &reused);
+    TraceSpan span = trace_begin("write_html", "serialize");
+    bool ok = write_html(g, lay, output);
+    if (ok) layout_save(lay, g, LAYOUT_FILE);
+    trace_end(span);
+    if (reused > 0) printf("Kept the positions of %d of %d modules.\n", reused, g->n);
+    layout_free(lay);
+    graph_free(g);
+    if (ok) printf("Generated %s successfully.\n", output);
+    else printf("Error: Could not write %s.\n", output);
+}
+
+// --- Link Rows ---
+
+// 'links rows' serves the GUI's virtual list. The link table is filtered
+// and sorted here and only the requested window is printed, so the GUI
+// holds a screenful of rows however large the model is:
+//   total  <matching rows>  <offset of the first printed row>
+//   found  <index of --find's link, or -1>
+//   row    <index>  src_mod  src_port  src_type  dst_mod  dst_port  dst_type
+
+#define ROW_FIELDS 6
+
+typedef struct {
+    const char* f[ROW_FIELDS];
+    int order; // Position in the model, so equal keys keep file order
+} LinkRow;
+
+const char* row_columns[ROW_FIELDS] = { "src_mod", "src_port", "src_type", "dst_mod", "dst_port", "dst_type" };
+int rows_sort_col = -1; // qsort takes no context, so the key is global
+bool rows_desc = false;
+
+int link_row_cmp(const void* a, const void* b) {
+    const LinkRow* x = (const LinkRow*)a;
+    const LinkRow* y = (const LinkRow*)b;
+    int c = rows_sort_col >= 0 ? strcmp(x->f[rows_sort_col], y->f[rows_sort_col]) : 0;
+    if (c == 0) c = (x->order > y->order) - (x->order < y->order);
+    return rows_desc ? -c : c;
+}
+
+bool link_row_matches(const LinkRow* r, const char* filter) {
+    for (int i = 0; i < ROW_FIELDS; i++)
+        if (strstr(r->f[i], filter)) return true;
+    return false;
+}
+
+void cmd_rows(int argc, char* argv[]) {
+    const char* sort = NULL;
+    const char* filter = NULL;
+    char* find = NULL;
+    long offset = 0, limit = 100;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--sort") == 0 && i + 1 < argc) sort = argv[++i];
+        else if (strncmp(argv[i], "--sort=", 7) == 0) sort = argv[i] + 7;
+        else if (strcmp(argv[i], "--desc") == 0) rows_desc = true;
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if (strncmp(argv[i], "--filter=", 9) == 0) filter = argv[i] + 9;
+        else if (strcmp(argv[i], "--offset") == 0 && i + 1 < argc) offset = atol(argv[++i]);
+        else if (strncmp(argv[i], "--offset=", 9) == 0) offset = atol(argv[i] + 9);
+        else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) limit = atol(argv[++i]);
+        else if (strncmp(argv[i], "--limit=", 8) == 0) limit = atol(argv[i] + 8);
+        else if (strcmp(argv[i], "--find") == 0 && i + 1 < argc) find = argv[++i];
+        else if (strncmp(argv[i], "--find=", 7) == 0) find = argv[i] + 7;
+        else { printf("Error: Unknown option for 'rows': %s\n", argv[i]); return; }
+    }
+    rows_sort_col = -1;
+    for (int c = 0; sort && c < ROW_FIELDS; c++)
+        if (strcmp(sort, row_columns[c]) == 0) rows_sort_col = c;
+    if (sort && rows_sort_col < 0) { printf("Error: Unknown sort column '%s'.\n", sort); return; }
+    char f_mod[MAX_STR], f_port[MAX_STR], tmp[MAX_STR];
+    if (find && !parse_arg_safe(find, f_mod, f_port, tmp)) { printf("Error: Invalid format for --find.\n"); return; }
+    if (limit < 0) limit = 0;
+    if (filter && !filter[0]) filter = NULL;
+
+    int cap = 0;
+    for (Module* m = root_modules; m; m = m->next)
+        for (Port* p = m->ports; p; p = p->next) cap++;
+    LinkRow* rows = (LinkRow*)xcalloc(cap ? cap : 1, sizeof(LinkRow));
+
+    int n = 0, order = 0;
+    for (Module* m = root_modules; m; m = m->next) {
+        for (Port* p = m->ports; p; p = p->next) {
+            if (p->dir != DIR_OUT || p->dest_module[0] == '\0' || p->dest_port[0] == '\0') continue;
+            Module* dm = get_module(p->dest_module, false);
+            Port* dp = dm ? get_port(dm, p->dest_port, false) : NULL;
+            LinkRow* r = &rows[n];
+            r->f[0] = m->name;
+            r->f[1] = p->name;
+            r->f[2] = p->type;
+            r->f[3] = p->dest_module;
+            r->f[4] = p->dest_port;
+            r->f[5] = dp ? dp->type : "";
+            r->order = order++;
+            if (!filter || link_row_matches(r, filter)) n++;
+        }
+    }
+    if (rows_sort_col >= 0 || rows_desc) qsort(rows, n, sizeof(LinkRow), link_row_cmp);
+
+    // --find centres the window on that link
+    int found = -1;
+    for (int i = 0; find && i < n; i++) {
+        if (strcmp(rows[i].f[0], f_mod) == 0 && strcmp(rows[i].f[1], f_port) == 0) { found = i; break; }
+    }
+    if (found >= 0) offset = found - limit / 2;
+    if (offset > n - limit) offset = n - limit;
+    if (offset < 0) offset = 0;
+
+    printf("total\t%d\t%ld\n", n, offset);
+    if (find) printf("found\t%d\n", found);
+    for (long i = offset; i < n && i < offset + limit; i++) {
+        const LinkRow* r = &rows[i];
+        printf("row\t%ld\t%s\t%s\t%s\t%s\t%s\t%s\n", i, r->f[0], r->f[1], r->f[2], r->f[3], r->f[4], r->f[5]);
+    }
+    free(rows);
+}
+
+// --- Memory Report ---
+
+// Live heap bytes by category, measured with the allocator's own chunk
+// sizes where glibc exposes them, so rounding and headers are included.
+
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 33)
+#define HAVE_MALLINFO2 1
+#endif
+#endif
+
+size_t heap_bytes(void* p, size_t requested) {
+    if (!p) return 0;
+#ifdef __GLIBC__
+    (void)requested;
+    return malloc_usable_size(p) + sizeof(size_t); // Plus the chunk header
+#else
+    return requested;
+#endif
+}
+
+size_t graph_heap_bytes(Graph* g) {
+    return heap_bytes(g, sizeof(Graph))
+         + heap_bytes(g->mods, module_count * sizeof(Module*))
+         + heap_bytes(g->node_of, module_count * sizeof(int))
+         + heap_bytes(g->succ_off, (g->n + 1) * sizeof(int))
+         + heap_bytes(g->pred_off, (g->n + 1) * sizeof(int))
+         + heap_bytes(g->succ, g->n_edges * sizeof(int))
+         + heap_bytes(g->pred, g->n_edges * sizeof(int));
+}
+
+void mem_line(const char* what, size_t bytes, const char* note) {
+    printf("  %-18s %14zu  %9.2f MB  %s\n", what, bytes, bytes / 1048576.0, note);
+}
+
+void cmd_mem() {
+    long ports = 0, links = 0;
+    size_t module_bytes = 0, port_bytes = 0, string_used = 0, string_reserved = 0;
+    for (Module* m = root_modules; m; m = m->next) {
+        module_bytes += heap_bytes(m, sizeof(Module));
+        string_reserved += sizeof(m->name) + sizeof(m->group);
+        string_used += strlen(m->name) + 1 + (m->group[0] ? strlen(m->group) + 1 : 0);
+        for (Port* p = m->ports; p; p = p->next) {
+            ports++;
+            if (p->dir == DIR_OUT && p->dest_module[0]) links++;
+            port_bytes += heap_bytes(p, sizeof(Port));
+            string_reserved += sizeof(p->name) + sizeof(p->type) + sizeof(p->dest_module) + sizeof(p->dest_port);
+            string_used += strlen(p->name) + strlen(p->type) + strlen(p->dest_module) + strlen(p->dest_port) + 4;
+        }
+    }
+    size_t index_bytes = heap_bytes(module_table, module_table_cap * sizeof(Module*));
+
+    // The CSR edge arrays only exist while an analysis command runs
+    Graph* g = graph_build(NULL);
+    size_t edge_bytes = graph_heap_bytes(g);
+    int n_edges = g->n_edges;
+    graph_free(g);
+
+    size_t model = module_bytes + port_bytes + index_bytes;
+    printf("Memory: %d modules, %ld ports, %ld links\n\n", module_count, ports, links);
+    printf("  %-18s %14s  %12s\n", "category", "bytes", "MB");
+    mem_line("module nodes", module_bytes, "");
+    mem_line("port nodes", port_bytes, "");
+    char note[96];
+    snprintf(note, sizeof(note), "inline in the nodes above; %.0f%% used",
+             string_reserved ? 100.0 * string_used / string_reserved : 0.0);
+    mem_line("  of which strings", string_reserved, note);
+    snprintf(note, sizeof(note), "module name index, %zu slots", module_table_cap);
+    mem_line("indexes", index_bytes, note);
+    mem_line("arenas", 0, "none; every node is its own allocation");
+    snprintf(note, sizeof(note), "graph index for %d edges, built per command", n_edges);
+    mem_line("edge arrays", edge_bytes, note);
+    mem_line("model total", model, "modules + ports + indexes");
+
+    printf("\n");
+    if (ports > 0) printf("  bytes per port     %14.1f\n", (double)model / ports);
+    if (n_edges > 0) printf("  bytes per edge     %14.1f  (edge arrays only)\n", (double)edge_bytes / n_edges);
+    if (ports > 0) printf("  at 10M ports       %14.2f GB  (model, same shape)\n", (double)model / ports * 1e7 / 1073741824.0);
+
+#ifdef HAVE_MALLINFO2
+    struct mallinfo2 mi = mallinfo2();
+    printf("  heap in use        %14zu  (all allocations, including I/O buffers)\n", mi.uordblks + mi.hblkhd);
+    printf("  heap free          %14zu  (held by the allocator)\n", mi.fordblks);
+#endif
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+        printf("  peak RSS           %14ld  (after load)\n", ru.ru_maxrss * 1024L);
+}
+
+// --- Synthetic Models ---
+
+// 'links gen' writes a reproducible model for performance work. Modules
+// sit in layers and are named <Subsystem>_L<layer>_<n>, so prefix
+// clusters match subsystems. Most links go to the next layer, some skip
+// ahead, some point back (cycles), hubs get a large share of the fan-out,
+// and ports left over are unconnected, many of them dir="none".
+
+typedef struct {
+    char dir;               // Direction
+    char type;              // Index into gen_types
+    int dest_mod;           // Module number, or -1
+    int dest_port;          // Port number in that module
+} GenPort;
+
+typedef struct {
+    int n, cap;
+    GenPort* ports;
+} GenModule;
+
+static const char* gen_subsystems[] = { "Sensor", "Fusion", "Perception", "Planning", "Control", "Actuator", "Comms", "Diag" };
+static const char* gen_types[] = { "int", "float", "bool", "frame", "pose", "cmd" };
+#define GEN_SUBSYSTEMS (int)(sizeof(gen_subsystems) / sizeof(gen_subsystems[0]))
+#define GEN_TYPES (int)(sizeof(gen_types) / sizeof(gen_types[0]))
+
+// splitmix64: the same seed gives the same model on every platform
+uint64_t gen_next(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+int gen_below(uint64_t* state, int n) {
+    return n > 0 ? (int)(gen_next(state) % (uint64_t)n) : 0;
+}
+
+int gen_add_port(GenModule* m, Direction dir, int type) {
+    if (m->n == m->cap) {
+        m->cap = m->cap ? m->cap * 2 : 8;
+        m->ports = (GenPort*)xrealloc(m->ports, m->cap * sizeof(GenPort));
+    }
+    m->ports[m->n] = (GenPort){ (char)dir, (char)type, -1, 0 };
+    return m->n++;
+}
+
+void gen_module_name(char* out, int i, int n_modules, int layers) {
+    int layer = (int)((long long)i * layers / n_modules);
+    snprintf(out, MAX_STR, "%s_L%d_%d", gen_subsystems[(i / 16) % GEN_SUBSYSTEMS], layer, i);
+}
+
+// Port names are derived from direction and position, e.g. in3, out0, cfg5
+void gen_port_name(char* out, GenPort* p, int k) {
+    const char* stem = p->dir == DIR_IN ? "in" : p->dir == DIR_OUT ? "out" : "cfg";
+    snprintf(out, MAX_STR, "%s%d", stem, k);
+}
+
+void cmd_gen(int argc, char* argv[]) {
+    int n = 1000, ports_per = 8, edges = -1;
+    uint64_t seed = 1;
+    const char* output = FILE_NAME;
+    bool force = false;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--modules") == 0 && i + 1 < argc) n = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ports-per") == 0 && i + 1 < argc) ports_per = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--edges") == 0 && i + 1 < argc) edges = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+        else if (strcmp(argv[i], "--force") == 0) force = true;
+        else { printf("Error: Unknown option for 'gen': %s\n", argv[i]); return; }
+    }
+    if (n < 2 || ports_per < 1) { printf("Error: Need at least 2 modules and 1 port per module.\n"); return; }
+    if (edges < 0) edges = (int)((long long)n * ports_per / 3);
+    if (!force && file_exists(output)) {
+        printf("Error: '%s' already exists (use --force to overwrite).\n", output);
+        return;
+    }
+
+    int layers = 3;
+    for (int m = n; m > 1; m /= 2) layers++;
+    if (layers > n) layers = n;
+    GenModule* mods = (GenModule*)xcalloc(n, sizeof(GenModule));
+    int n_hubs = n / 50 + 1;
+    uint64_t rng = seed;
+
+    for (int e = 0; e < edges; e++) {
+        // A quarter of all links start at a hub
+        int u = gen_below(&rng, n);
+        if (gen_below(&rng, 4) == 0) u = (int)((long long)gen_below(&rng, n_hubs) * n / n_hubs);
+        int lu = (int)((long long)u * layers / n);
+
+        // 70% to the next layer, 18% further ahead, the rest back or sideways
+        int r = gen_below(&rng, 100), lv;
+        if (r < 70 && lu + 1 < layers) lv = lu + 1;
+        else if (r < 88 && lu + 2 < layers) lv = lu + 2 + gen_below(&rng, layers - lu - 2 < 3 ? layers - lu - 2 : 3);
+        else lv = gen_below(&rng, lu + 1);
+        int first = (int)(((long long)lv * n + layers - 1) / layers);
+        int last = (int)(((long long)(lv + 1) * n + layers - 1) / layers);
+        int v = first + gen_below(&rng, last - first);
+        if (v == u) v = (v + 1) % n;
+
+        // Fan-in: a third of the time reuse an input of the same type
+        int type = gen_below(&rng, GEN_TYPES);
+        int in_port = -1;
+        if (gen_below(&rng, 3) == 0) {
+            for (int k = mods[v].n - 1; k >= 0 && k >= mods[v].n - 8; k--)
+                if (mods[v].ports[k].dir == DIR_IN && mods[v].ports[k].type == type) { in_port = k; break; }
+        }
+        if (in_port < 0) in_port = gen_add_port(&mods[v], DIR_IN, type);
+        int out_port = gen_add_port(&mods[u], DIR_OUT, type);
+        mods[u].ports[out_port].dest_mod = v;
+        mods[u].ports[out_port].dest_port = in_port;
+    }
+
+    // Pad every module to the requested port count with unconnected ports
+    long long total_ports = 0;
+    for (int i = 0; i < n; i++) {
+        while (mods[i].n < ports_per) {
+            int r = gen_below(&rng, 4);
+            gen_add_port(&mods[i], r < 2 ? DIR_NONE : r == 2 ? DIR_IN : DIR_OUT, gen_below(&rng, GEN_TYPES));
+        }
+        total_ports += mods[i].n;
+    }
+
+    FILE* f = fopen(output, "w");
+    if (!f) { printf("Error: Could not write '%s'.\n", output); return; }
+    char name[MAX_STR], port[MAX_STR], dest[MAX_STR], dest_port[MAX_STR];
+    fprintf(f, "<root>\n");
+    for (int i = 0; i < n; i++) {
+        gen_module_name(name, i, n, layers);
+        fprintf(f, "  <module name=\"%s\">\n", name);
+        for (int k = 0; k < mods[i].n; k++) {
+            GenPort* p = &mods[i].ports[k];
+            gen_port_name(port, p, k);
+            dest[0] = dest_port[0] = '\0';
+            if (p->dest_mod >= 0) {
+                gen_module_name(dest, p->dest_mod, n, layers);
+                gen_port_name(dest_port, &mods[p->dest_mod].ports[p->dest_port], p->dest_port);
             }
-            p = p->next;
+            fprintf(f, "    <port name=\"%s\" type=\"%s\" dir=\"%s\" dest_mod=\"%s\" dest_port=\"%s\" />\n",
+                    port, gen_types[(int)p->type], dir_to_str((Direction)p->dir), dest, dest_port);
         }
-        m = m->next;
+        fprintf(f, "  </module>\n");
+    }
+    fprintf(f, "</root>\n");
+    for (int i = 0; i < n; i++) free(mods[i].ports);
+    free(mods);
+    if (fclose_counted(f) != 0) { printf("Error: Could not write '%s'.\n", output); return; }
+    printf("Generated %s: %d modules in %d layers, %lld ports, %d links (seed %llu).\n",
+           output, n, layers, total_ports, edges, (unsigned long long)seed);
+}
+
+void cmd_group(int argc, char* argv[]) {
+    if (argc != 3 && argc != 4) {
+        printf("Usage: links group Module [GroupName]\n");
+        return;
     }
+    Module* m = get_module(argv[2], false);
+    if (!m) { printf("Error: Module '%s' not found.\n", argv[2]); return; }
 
-    fprintf(f, "}\n");
-    fclose(f);
-    
-    system("dot -Tsvg graph.dot -o graph.svg");
-    system("dot -Tpng graph.dot -o graph.png");
-    printf("Generated graph.svg successfully.\n");
+    if (argc == 3) {
+        m->group[0] = '\0';
+        printf("Module '%s' removed from its group.\n", m->name);
+        return;
+    }
+    if (strchr(argv[3], '"') || strchr(argv[3], '<') || strchr(argv[3], '&')) {
+        printf("Error: Group name must not contain '\"', '<' or '&'.\n");
+        return;
+    }
+    strncpy(m->group, argv[3], MAX_STR - 1);
+    m->group[MAX_STR - 1] = '\0';
+    printf("Module '%s' is now in group '%s'.\n", m->name, m->group);
+}
+
+void cmd_check() {
+    CheckCtx ctx;
+    int n = 0;
+    ctx.mods = module_array(&n);
+    ctx.reports = (char**)xcalloc(n, sizeof(char*));
+    atomic_init(&ctx.issues, 0);
+
+    // Lookups are read-only here, so modules can be checked independently
+    pool_parallel_for(n, 64, check_range, &ctx);
+
+    for (int i = 0; i < n; i++) {
+        if (ctx.reports[i]) fputs(ctx.reports[i], stdout);
+        free(ctx.reports[i]);
+    }
+    int issues = atomic_load(&ctx.issues);
+    if (issues == 0) printf("Check passed: %d modules, no issues.\n", n);
+    else printf("Check found %d issue(s) across %d modules.\n", issues, n);
+
+    free(ctx.reports);
+    free(ctx.mods);
+}
+
+// Strips global options out of argv so commands keep their fixed positions
+int parse_global_options(int argc, char* argv[]) {
+    int out = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opt_threads = atoi(argv[++i]);
+            if (opt_threads < 1) opt_threads = 1;
+            if (opt_threads > MAX_THREADS) opt_threads = MAX_THREADS;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            prof.enabled = true;
+        } else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            prof.enabled = true;
+            prof.json_path = argv[i] + 10;
+        } else if (strcmp(argv[i], "--events") == 0) {
+            opt_events = true;
+        } else if (strcmp(argv[i], "--perf-counters") == 0) {
+            prof.enabled = true; // Counters are reported with the profile
+            prof.counters = true;
+        } else {
+            argv[out++] = argv[i];
+        }
+    }
+    argv[out] = NULL;
+    return out;
+}
+
+bool command_modifies_model(const char* cmd) {
+    static const char* writers[] = { "add", "remove", "relink", "set", "edit", "ed", "mvu", "mvd", "group" };
+    for (size_t i = 0; i < sizeof(writers) / sizeof(writers[0]); i++)
+        if (strcmp(cmd, writers[i]) == 0) return true;
+    return false;
 }
 
 int main(int argc, char* argv[]) {
+    argc = parse_global_options(argc, argv);
+    trace_init();
+    if (prof.counters) hw_counters_open();
+
     // If no arguments or user asks for help
     if (argc < 2 || strcmp(argv[1], "help") == 0 || strcmp(argv[1], "-h") == 0) {
         print_usage();
         return 0;
     }
 
+    // 'gen' writes a model of its own and leaves the current one alone
+    if (strcmp(argv[1], "gen") == 0) {
+        ProfMark start = prof_mark();
+        TraceSpan span = trace_begin("gen", "cmd");
+        cmd_gen(argc, argv);
+        trace_end(span);
+        prof_end(PHASE_COMMAND, start);
+        prof_report();
+        trace_write();
+        return 0;
+    }
+
+    ProfMark start = prof_mark();
     load_xml();
+    prof_end(PHASE_LOAD, start);
+
+    start = prof_mark();
+    TraceSpan span = trace_begin(argv[1], "cmd");
 
     if (strcmp(argv[1], "add") == 0) cmd_add(argc, argv);
     else if (strcmp(argv[1], "edit") == 0 || strcmp(argv[1], "ed") == 0) cmd_edit(argc, argv); // <-- NEW
@@ -630,13 +4282,32 @@ int main(int argc, char* argv[]) {
     else if (strcmp(argv[1], "mvd") == 0) cmd_move_port_down(argc, argv); // <-- NEW
     else if (strcmp(argv[1], "list") == 0 && argc > 2) cmd_list(argv[2]);
     else if (strcmp(argv[1], "remove") == 0) cmd_remove(argc, argv);
+    else if (strcmp(argv[1], "relink") == 0) cmd_relink(argc, argv);
+    else if (strcmp(argv[1], "set") == 0) cmd_set(argc, argv);
     else if (strcmp(argv[1], "draw") == 0) cmd_draw();
-    else if (strcmp(argv[1], "dot") == 0) cmd_dot();
+    else if (strcmp(argv[1], "dot") == 0) cmd_dot(argc, argv);
+    else if (strcmp(argv[1], "check") == 0) cmd_check();
+    else if (strcmp(argv[1], "group") == 0) cmd_group(argc, argv);
+    else if (strcmp(argv[1], "dsm") == 0) cmd_dsm(argc, argv);
+    else if (strcmp(argv[1], "export") == 0) cmd_export(argc, argv);
+    else if (strcmp(argv[1], "mem") == 0) cmd_mem();
+    else if (strcmp(argv[1], "rows") == 0) cmd_rows(argc, argv);
     else {
         printf("Unknown command: %s\n", argv[1]);
         print_usage();
     }
-    
-    save_xml();
+    pool_shutdown();
+    trace_end(span);
+    prof_end(PHASE_COMMAND, start);
+
+    // Only commands that change the model write it back, so read-only
+    // ones (a background 'dot' from the GUI) never race an edit
+    if (command_modifies_model(argv[1])) {
+        start = prof_mark();
+        save_xml();
+        prof_end(PHASE_SAVE, start);
+    }
+    prof_report();
+    trace_write();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Command-line checks for links: each case runs the binary in a scratch
+# directory and compares the saved model or the output. Run with
+# 'make test'.
+
+LINKS=${LINKS:-$(pwd)/src/links}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+failed=0
+
+fail() { echo "FAIL: $1"; failed=$((failed + 1)); }
+
+# Ports are matched on their saved XML line
+port_line() { grep "<port name=\"$2\"" links_data.xml | head -1; }
+
+# set: an empty dest unlinks the port and leaves it 'none', as 'remove' does
+rm -f links_data.xml
+"$LINKS" add A::out B::in > /dev/null
+"$LINKS" set A::out dest= > /dev/null
+case $(port_line A out) in
+    *'dir="none"'*'dest_mod=""'*) ;;
+    *) fail "set dest= left A::out as: $(port_line A out)" ;;
+esac
+
+# set: a port with no fields is rejected and the model is left alone
+rm -f links_data.xml
+"$LINKS" add A::out B::in > /dev/null
+cp links_data.xml before.xml
+out=$("$LINKS" set A::out type=int C::typo)
+case $out in
+    *"No fields given for 'C::typo'"*) ;;
+    *) fail "set with a bare trailing port printed: $out" ;;
+esac
+cmp -s before.xml links_data.xml || fail "set with a bare trailing port changed the model"
+out=$("$LINKS" set A::typo B::in type=int)
+case $out in
+    *"No fields given for 'A::typo'"*) ;;
+    *) fail "set with a bare leading port printed: $out" ;;
+esac
+cmp -s before.xml links_data.xml || fail "set with a bare leading port changed the model"
+
+if [ "$failed" -gt 0 ]; then
+    echo "$failed check(s) failed"
+    exit 1
+fi
+echo "All CLI checks passed"